@@ -1,5 +1,8 @@
 #include "NeuralNetwork.h"
+#include "TargetNetwork.h"
 #include "ReplayBuffer.h"
+#include "../Profiler.h"
+#include <array>
 #include <random>
 #include <string>
 #include <vector>
@@ -8,20 +11,34 @@
 class Agent {
 public:
     NeuralNetwork q_network;
-    NeuralNetwork target_q_network;
+    TargetNetwork target_q_network;
     ReplayBuffer replay_buffer;
 
     double epsilon;
     double epsilon_decay;
     double min_epsilon;
     double gamma;
+    // 0 keeps the periodic hard sync, otherwise the target is blended by tau after every learning step
+    double target_tau = 0.0;
     int action_space_size;
+    // prioritized replay, see set_prioritized_replay(); beta anneals from priority_beta to 1
+    double priority_beta = 0.4;
+    size_t priority_beta_steps = 100000;
+    size_t learn_steps = 0;
 
     int maxX;
     int maxY;
 
     std::mt19937 rng;
 
+    // current replay minibatch, its Q targets and TD errors, reused across steps
+    ReplayBatch replay_batch;
+    std::vector<double> batch_targets;
+    std::vector<double> batch_td_errors;
+    // precomputed per-cell features of the track, empty until built by the trainer.
+    // Replayed states are rebuilt from it, so it must be built before training.
+    FeatureTable state_features;
+
     Agent(std::vector<int> layerSizes,
           size_t buffer_capacity,
           double initial_epsilon,
@@ -30,8 +47,8 @@ public:
           double discount_factor,
           int num_actions,
           std::string path)
-        : q_network(layerSizes, initial_epsilon, 0.001, path + "/target_q_network"),
-          target_q_network(layerSizes, initial_epsilon, 0.001, path + "/target_q_network"),
+        : q_network(layerSizes, initial_epsilon, 0.001, path + "/q_network"),
+          target_q_network(q_network),
           replay_buffer(buffer_capacity),
           epsilon(initial_epsilon),
           epsilon_decay(decay),
@@ -40,58 +57,111 @@ public:
           action_space_size(num_actions),
           rng(std::random_device{}())
     {
-        update_target_network();
     }
 
     // Epsilon-greedy action selection
     int select_action(const State& current_state) {
+        PROFILE_SCOPE("select_action");
         std::uniform_real_distribution<double> dist(0.0, 1.0);
         if (dist(rng) < epsilon) {
             std::uniform_int_distribution<int> action_dist(0, action_space_size - 1);
             return action_dist(rng);
         } else {
-            std::vector<double> q_values = q_network.forward(current_state.toVector());
-            return std::distance(q_values.begin(), std::max_element(q_values.begin(), q_values.end()));
+            std::array<net_scalar, State::NUM_FEATURES> features;
+            state_features.encode(current_state, features.data());
+            const net_scalar* q_values = q_network.forward(features.data(), 1, NeuralNetwork::threadWorkspace());
+            return std::distance(q_values, std::max_element(q_values, q_values + q_network.outputSize()));
         }
     }
 
-    void store_transition(const State& s, int a, double r, const State& s_prime, bool done) {
-        Transition t = { s, a, r, s_prime, done };
-        replay_buffer.add(t);
+    // Epsilon-greedy over `count` encoded states stored row by row, one network call for all of them
+    void select_actions(const net_scalar* features, int count, int* actions) {
+        PROFILE_SCOPE("select_action");
+        const net_scalar* q_values = q_network.forward(features, count, NeuralNetwork::threadWorkspace());
+        choose_actions(q_values, count, q_network.outputSize(), epsilon, rng, actions);
     }
 
-    // Learning from past experience
-    void experience_replay(size_t batch_size) {
-        if (replay_buffer.size() < batch_size) return;
+    // epsilon-greedy choice from a [count x n_actions] matrix of Q-values
+    static void choose_actions(const net_scalar* q_values, int count, int n_actions, double epsilon,
+                               std::mt19937& rng, int* actions) {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        std::uniform_int_distribution<int> action_dist(0, n_actions - 1);
+        for (int i = 0; i < count; ++i) {
+            if (dist(rng) < epsilon) {
+                actions[i] = action_dist(rng);
+            } else {
+                const net_scalar* row = q_values + static_cast<size_t>(i) * n_actions;
+                actions[i] = std::distance(row, std::max_element(row, row + n_actions));
+            }
+        }
+    }
 
-        std::vector<Transition> batch = replay_buffer.sample(batch_size);
-        std::vector<std::tuple<ReplayRecord, double>> training_batch;
+    // episode_end: last step of an episode cut off by the step limit, needed by n-step returns
+    void store_transition(const State& s, int a, double r, const State& s_prime, bool done, bool episode_end = false) {
+        replay_buffer.add(packState(s), a, r, packState(s_prime), done, episode_end);
+    }
 
-        for (const auto& trans : batch) {
-            std::vector<double> next_q_values = target_q_network.forward(trans.nextState.toVector());
-            double max_next_q = trans.done ? 0.0 : *std::max_element(next_q_values.begin(), next_q_values.end());
+    // alpha > 0 samples transitions by |TD error|^alpha and corrects the bias with
+    // importance weights; beta starts at `beta` and reaches 1 after `beta_steps` learning steps
+    void set_prioritized_replay(double alpha, double beta = 0.4, size_t beta_steps = 100000) {
+        replay_buffer.setPriorityExponent(alpha);
+        priority_beta = beta;
+        priority_beta_steps = beta_steps;
+    }
 
-            double target_q = trans.reward + gamma * max_next_q;
+    // replayed targets sum the rewards of up to n steps before bootstrapping, 1 is one-step Q-learning
+    void set_n_step(int n) {
+        replay_buffer.setNStep(n, gamma);
+    }
+
+    // importance-sampling exponent for the next learning step
+    double importance_beta() const {
+        return std::min(1.0, priority_beta + (1.0 - priority_beta) * learn_steps / std::max<size_t>(1, priority_beta_steps));
+    }
+
+    // Learning from past experience
+    void experience_replay(size_t batch_size) {
+        if (replay_buffer.size() < batch_size) return;
 
-            ReplayRecord record(
-                trans.state,
-                static_cast<Action>(trans.action),
-                trans.reward,
-                trans.nextState,
-                trans.done
-            );
+        PROFILE_SCOPE("experience_replay");
+        replay_buffer.sample(batch_size, state_features, replay_batch, importance_beta());
+        learn_from(replay_batch);
+        replay_buffer.updatePriorities(replay_batch.indices.data(), batch_td_errors.data(), replay_batch.size);
+    }
 
-            training_batch.emplace_back(record, target_q);
+    // one learning step on transitions sampled by the caller
+    void learn_from(const ReplayBatch& batch) {
+        if (batch.size == 0) return;
+
+        {
+            PROFILE_SCOPE("target_eval");
+            // evaluate the target network on every next state in one pass
+            const net_scalar* next_q_values = target_q_network.forward(batch.next_states.data(), batch.size,
+                                                                       NeuralNetwork::threadWorkspace());
+            const int n_actions = target_q_network.outputSize();
+
+            batch_targets.resize(batch.size);
+            for (int i = 0; i < batch.size; ++i) {
+                const net_scalar* row = next_q_values + static_cast<size_t>(i) * n_actions;
+                double max_next_q = batch.dones[i] ? 0.0 : *std::max_element(row, row + n_actions);
+                // n-step samples bring the discount of the state they bootstrap from
+                const double discount = batch.discounts.empty() ? gamma : batch.discounts[i];
+                batch_targets[i] = batch.rewards[i] + discount * max_next_q;
+            }
         }
 
-        if (!training_batch.empty()) {
-            q_network.learn(training_batch);
+        // TD errors come back for the priority update of prioritized replay
+        batch_td_errors.resize(batch.size);
+        q_network.learn(batch.states.data(), batch.actions.data(), batch_targets.data(), batch.size,
+                        batch.weights.empty() ? nullptr : batch.weights.data(), batch_td_errors.data());
+        ++learn_steps;
+        if (target_tau > 0.0) {
+            target_q_network.softUpdate(q_network, target_tau);
         }
-        
     }
 
     void update_target_network() {
-        target_q_network = q_network;
+        target_q_network.copyFrom(q_network);
     }
 
 };
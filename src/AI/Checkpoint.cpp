@@ -0,0 +1,234 @@
+#include "Checkpoint.h"
+#include "../Log.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignTo64(uint64_t offset) {
+    return (offset + 63) / 64 * 64;
+}
+
+size_t checkpointPadded(size_t n, size_t scalarBytes) {
+    const size_t line = 64 / scalarBytes;
+    return (n + line - 1) / line * line;
+}
+
+size_t checkpointLayerElements(const CheckpointLayer& layer, size_t scalarBytes) {
+    return checkpointPadded(static_cast<size_t>(layer.n_inputs) * layer.n_outputs, scalarBytes)
+         + checkpointPadded(layer.n_outputs, scalarBytes);
+}
+
+uint64_t checkpointChecksum(const unsigned char* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// ---------------------------------------------------------------- reading
+
+MappedCheckpoint::~MappedCheckpoint() {
+    close();
+}
+
+void MappedCheckpoint::close() {
+    if (base) {
+        munmap(const_cast<unsigned char*>(base), length);
+        base = nullptr;
+        length = 0;
+    }
+}
+
+bool MappedCheckpoint::open(const std::string& file_path, bool verifyChecksum) {
+    close();
+
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("Could not open checkpoint " << file_path);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CheckpointHeader)) {
+        LOG_ERROR("Error: " << file_path << " is too small to be a checkpoint");
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG_ERROR("Error: could not map checkpoint " << file_path);
+        length = 0;
+        return false;
+    }
+    base = static_cast<const unsigned char*>(mapped);
+
+    const CheckpointHeader& h = header();
+    // a section of `section_elements` elements, `bytes` wide, fits in the file at
+    // `offset`; divides instead of multiplying so a forged header cannot wrap it
+    auto sectionFits = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= length && h.section_elements <= (length - offset) / bytes;
+    };
+    const char* problem = nullptr;
+    if (std::memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) {
+        problem = "not a checkpoint file";
+    } else if (h.version != CHECKPOINT_VERSION) {
+        problem = "unsupported checkpoint version";
+    } else if ((h.scalar_bytes != 4 && h.scalar_bytes != 8) || (h.moment_bytes != 0 && h.moment_bytes != 4 && h.moment_bytes != 8)) {
+        problem = "unsupported element type";
+    } else if (sizeof(CheckpointHeader) + static_cast<uint64_t>(h.num_layers) * sizeof(CheckpointLayer) > h.params_offset
+               || !sectionFits(h.params_offset, h.scalar_bytes)
+               || (h.moment_bytes && (!sectionFits(h.first_moment_offset, h.moment_bytes)
+                                      || !sectionFits(h.second_moment_offset, h.moment_bytes)))) {
+        problem = "truncated checkpoint";
+    } else if (verifyChecksum && checkpointChecksum(base + sizeof(CheckpointHeader), length - sizeof(CheckpointHeader)) != h.checksum) {
+        problem = "checksum mismatch";
+    }
+
+    if (!problem) {
+        // stops at the first layer past the sections, so the sum cannot wrap either
+        size_t elements = 0;
+        for (uint32_t i = 0; i < h.num_layers && elements <= h.section_elements; ++i) {
+            if (layer(i).n_inputs <= 0 || layer(i).n_outputs <= 0) {
+                elements = h.section_elements + 1;
+                break;
+            }
+            elements += checkpointLayerElements(layer(i), h.scalar_bytes);
+        }
+        if (elements != h.section_elements) problem = "layer table does not match the sections";
+    }
+
+    if (problem) {
+        LOG_ERROR("Error: " << file_path << ": " << problem);
+        close();
+        return false;
+    }
+    return true;
+}
+
+const CheckpointLayer& MappedCheckpoint::layer(int i) const {
+    return reinterpret_cast<const CheckpointLayer*>(base + sizeof(CheckpointHeader))[i];
+}
+
+const void* MappedCheckpoint::firstMoments() const {
+    return hasMoments() ? base + header().first_moment_offset : nullptr;
+}
+
+const void* MappedCheckpoint::secondMoments() const {
+    return hasMoments() ? base + header().second_moment_offset : nullptr;
+}
+
+size_t MappedCheckpoint::weightsOffset(int i) const {
+    size_t offset = 0;
+    for (int l = 0; l < i; ++l) {
+        offset += checkpointLayerElements(layer(l), header().scalar_bytes);
+    }
+    return offset;
+}
+
+// ---------------------------------------------------------------- writing
+
+CheckpointWriter::~CheckpointWriter() {
+    if (file) {
+        std::fclose(file);
+        std::remove(tmpPath.c_str());
+    }
+}
+
+bool CheckpointWriter::begin(const std::string& file_path, uint32_t scalar_bytes, uint32_t moment_bytes,
+                             const std::vector<CheckpointLayer>& layers) {
+    path = file_path;
+    tmpPath = file_path + ".tmp";
+    file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR("Could not open file for saving: " << tmpPath);
+        return false;
+    }
+
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.scalar_bytes = scalar_bytes;
+    header.moment_bytes = moment_bytes;
+    header.num_layers = static_cast<uint32_t>(layers.size());
+    header.section_elements = 0;
+    for (const auto& layer : layers) {
+        header.section_elements += checkpointLayerElements(layer, scalar_bytes);
+    }
+    header.params_offset = alignTo64(sizeof(CheckpointHeader) + layers.size() * sizeof(CheckpointLayer));
+    header.first_moment_offset = 0;
+    header.second_moment_offset = 0;
+    if (moment_bytes) {
+        header.first_moment_offset = alignTo64(header.params_offset + header.section_elements * scalar_bytes);
+        header.second_moment_offset = alignTo64(header.first_moment_offset + header.section_elements * moment_bytes);
+    }
+
+    // the real header is written by finish(), once the checksum is known
+    CheckpointHeader placeholder{};
+    if (std::fwrite(&placeholder, sizeof(placeholder), 1, file) != 1) return false;
+    position = sizeof(CheckpointHeader);
+    hash = CHECKPOINT_HASH_SEED;
+    sectionsStarted = 0;
+    return writeRaw(layers.data(), layers.size() * sizeof(CheckpointLayer));
+}
+
+bool CheckpointWriter::beginSection() {
+    const uint64_t offsets[3] = {header.params_offset, header.first_moment_offset, header.second_moment_offset};
+    const int sections = header.moment_bytes ? 3 : 1;
+    if (sectionsStarted >= sections) {
+        LOG_ERROR("Error: checkpoint " << path << " has no more sections");
+        return false;
+    }
+    uint64_t target = offsets[sectionsStarted++];
+    return target >= position && writeZeros(target - position);
+}
+
+bool CheckpointWriter::writeBlock(const void* data, size_t n, size_t elementBytes) {
+    return writeRaw(data, n * elementBytes)
+        && writeZeros((checkpointPadded(n, header.scalar_bytes) - n) * elementBytes);
+}
+
+bool CheckpointWriter::finish() {
+    const int sections = header.moment_bytes ? 3 : 1;
+    const uint64_t lastStart = header.moment_bytes ? header.second_moment_offset : header.params_offset;
+    const uint64_t lastBytes = header.section_elements * (header.moment_bytes ? header.moment_bytes : header.scalar_bytes);
+    if (sectionsStarted != sections || position != lastStart + lastBytes) {
+        LOG_ERROR("Error: checkpoint " << path << " is incomplete, not saving it");
+        return false;
+    }
+
+    header.checksum = hash;
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOG_ERROR("Error: could not write checkpoint " << path);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CheckpointWriter::writeRaw(const void* data, size_t size) {
+    if (size == 0) return true;
+    if (!file || std::fwrite(data, 1, size, file) != size) {
+        LOG_ERROR("Error: failed writing checkpoint " << path);
+        return false;
+    }
+    hash = checkpointChecksum(static_cast<const unsigned char*>(data), size, hash);
+    position += size;
+    return true;
+}
+
+bool CheckpointWriter::writeZeros(size_t size) {
+    static const unsigned char zeros[64] = {};
+    while (size > 0) {
+        size_t chunk = size < sizeof(zeros) ? size : sizeof(zeros);
+        if (!writeRaw(zeros, chunk)) return false;
+        size -= chunk;
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Binary network checkpoint (.rlck).
+//
+//   CheckpointHeader                        64 bytes
+//   CheckpointLayer[num_layers]             shapes and per-layer Adam state
+//   parameters        (64 byte aligned)     per layer: weights | biases
+//   first moments     (optional)            same layout in the moment type
+//   second moments    (optional)
+//
+// Blocks are padded to a cache line of parameters, exactly like ParameterArena,
+// so every section has the same element layout and a network whose types match
+// the file copies each section in one go. `checksum` is FNV-1a over everything
+// after the header.
+
+static const char CHECKPOINT_MAGIC[8] = {'R', 'L', 'C', 'K', 'P', 'T', '\0', '\0'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t scalar_bytes;    // 4 (float) or 8 (double) parameters
+    uint32_t moment_bytes;    // 0 when the file carries no optimizer state
+    uint32_t num_layers;
+    uint64_t params_offset;   // byte offsets from the start of the file
+    uint64_t first_moment_offset;
+    uint64_t second_moment_offset;
+    uint64_t section_elements; // elements per section, padding included
+    uint64_t checksum;
+};
+static_assert(sizeof(CheckpointHeader) == 64, "checkpoint header must stay 64 bytes");
+
+struct CheckpointLayer {
+    int32_t n_inputs;
+    int32_t n_outputs;
+    int32_t is_output;
+    int32_t reserved;
+    int64_t training_steps;
+    double alpha;
+    double beta_one;
+    double beta_two;
+    double epsilon;
+    double beta_one_power;
+    double beta_two_power;
+};
+
+// n rounded up to a whole cache line of `scalarBytes` wide parameters
+size_t checkpointPadded(size_t n, size_t scalarBytes);
+// elements taken by one layer in every section
+size_t checkpointLayerElements(const CheckpointLayer& layer, size_t scalarBytes);
+
+static const uint64_t CHECKPOINT_HASH_SEED = 14695981039346656037ull;
+// FNV-1a, pass the previous result as `hash` to continue a running checksum
+uint64_t checkpointChecksum(const unsigned char* data, size_t size, uint64_t hash = CHECKPOINT_HASH_SEED);
+
+// n elements stored `bytes` wide (4 = float, 8 = double) converted to T
+template <typename T>
+void checkpointReadElements(const void* src, size_t bytes, T* dst, size_t n) {
+    if (bytes == sizeof(T)) {
+        std::memcpy(dst, src, n * sizeof(T));
+    } else if (bytes == sizeof(float)) {
+        const float* f = static_cast<const float*>(src);
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<T>(f[i]);
+    } else {
+        const double* d = static_cast<const double*>(src);
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<T>(d[i]);
+    }
+}
+
+// Read-only checkpoint mapped into memory. Sections are only paged in when
+// touched, so opening is instant and weights can be read in place.
+class MappedCheckpoint {
+public:
+    MappedCheckpoint() = default;
+    ~MappedCheckpoint();
+    MappedCheckpoint(const MappedCheckpoint&) = delete;
+    MappedCheckpoint& operator=(const MappedCheckpoint&) = delete;
+
+    // maps and validates the file, prints the reason and returns false on failure
+    bool open(const std::string& file_path, bool verifyChecksum = true);
+    void close();
+
+    const CheckpointHeader& header() const { return *reinterpret_cast<const CheckpointHeader*>(base); }
+    const CheckpointLayer& layer(int i) const;
+    bool hasMoments() const { return header().moment_bytes != 0; }
+
+    // start of a section, nullptr for absent moment sections
+    const void* params() const { return base + header().params_offset; }
+    const void* firstMoments() const;
+    const void* secondMoments() const;
+
+    // element offset of layer i's weights inside any section, its biases
+    // follow at weightsOffset + checkpointPadded(n_in * n_out, scalar_bytes)
+    size_t weightsOffset(int i) const;
+
+private:
+    const unsigned char* base = nullptr;
+    size_t length = 0;
+};
+
+// Writes a checkpoint section by section, computing the checksum on the way.
+// The file is written next to its destination and renamed into place, so a
+// crash never leaves a half-written checkpoint behind.
+class CheckpointWriter {
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    bool begin(const std::string& file_path, uint32_t scalar_bytes, uint32_t moment_bytes,
+               const std::vector<CheckpointLayer>& layers);
+    // starts the parameter, first moment, then second moment section
+    bool beginSection();
+    // next weights or biases block: n elements of `elementBytes`, then padding like the arena.
+    // A whole ParameterArena buffer is also a valid block, its size is already padded.
+    bool writeBlock(const void* data, size_t n, size_t elementBytes);
+    bool finish();
+
+private:
+    bool writeRaw(const void* data, size_t size);
+    bool writeZeros(size_t size);
+
+    std::string path;
+    std::string tmpPath;
+    std::FILE* file = nullptr;
+    CheckpointHeader header{};
+    uint64_t hash = 0;
+    uint64_t position = 0;
+    int sectionsStarted = 0;
+};
@@ -0,0 +1,75 @@
+#include "Gemm.h"
+#include "Kernels.h"
+#include <algorithm>
+
+// block sizes chosen so a K block of B (KC x NC values) stays in L2
+static const int MC = 64;
+static const int KC = 128;
+static const int NC = 256;
+
+template <typename T>
+void gemmNN(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+    const KernelTable<T>& k = kernels<T>();
+    for (int j0 = 0; j0 < N; j0 += NC) {
+        int jEnd = std::min(j0 + NC, N);
+        for (int k0 = 0; k0 < K; k0 += KC) {
+            int kEnd = std::min(k0 + KC, K);
+            for (int i0 = 0; i0 < M; i0 += MC) {
+                int iEnd = std::min(i0 + MC, M);
+                for (int i = i0; i < iEnd; ++i) {
+                    T* cRow = C + i * ldc;
+                    for (int p = k0; p < kEnd; ++p) {
+                        T a = A[i * lda + p];
+                        if (a == 0.0) continue; // ReLU activations are often zero
+                        k.axpy(a, B + p * ldb + j0, cRow + j0, jEnd - j0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void gemmTN(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+    const KernelTable<T>& k = kernels<T>();
+    for (int j0 = 0; j0 < N; j0 += NC) {
+        int jEnd = std::min(j0 + NC, N);
+        for (int i0 = 0; i0 < M; i0 += MC) {
+            int iEnd = std::min(i0 + MC, M);
+            for (int k0 = 0; k0 < K; k0 += KC) {
+                int kEnd = std::min(k0 + KC, K);
+                for (int p = k0; p < kEnd; ++p) {
+                    const T* aRow = A + p * lda;
+                    const T* bRow = B + p * ldb + j0;
+                    for (int i = i0; i < iEnd; ++i) {
+                        T a = aRow[i];
+                        if (a == 0.0) continue;
+                        k.axpy(a, bRow, C + i * ldc + j0, jEnd - j0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void gemmNT(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+    const KernelTable<T>& k = kernels<T>();
+    for (int j0 = 0; j0 < N; j0 += MC) {
+        int jEnd = std::min(j0 + MC, N);
+        for (int i = 0; i < M; ++i) {
+            const T* aRow = A + i * lda;
+            T* cRow = C + i * ldc;
+            for (int j = j0; j < jEnd; ++j) {
+                cRow[j] += k.dot(aRow, B + j * ldb, K);
+            }
+        }
+    }
+}
+
+template void gemmNN<double>(int, int, int, const double*, int, const double*, int, double*, int);
+template void gemmTN<double>(int, int, int, const double*, int, const double*, int, double*, int);
+template void gemmNT<double>(int, int, int, const double*, int, const double*, int, double*, int);
+template void gemmNN<float>(int, int, int, const float*, int, const float*, int, float*, int);
+template void gemmTN<float>(int, int, int, const float*, int, const float*, int, float*, int);
+template void gemmNT<float>(int, int, int, const float*, int, const float*, int, float*, int);
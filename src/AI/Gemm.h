@@ -0,0 +1,17 @@
+#pragma once
+
+// Blocked row-major matrix products used by the batched layer passes.
+// All routines accumulate into C (C += ...), callers initialize C.
+// Instantiated for float and double.
+
+// C[M x N] += A[M x K] * B[K x N]
+template <typename T>
+void gemmNN(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc);
+
+// C[M x N] += A^T * B, with A stored as [K x M] and B as [K x N]
+template <typename T>
+void gemmTN(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc);
+
+// C[M x N] += A * B^T, with A stored as [M x K] and B as [N x K]
+template <typename T>
+void gemmNT(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc);
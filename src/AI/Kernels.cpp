@@ -0,0 +1,701 @@
+#include "Kernels.h"
+#include "../Log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RL_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------- scalar
+
+template <typename T>
+static T dotScalar(const T* a, const T* b, int n) {
+    T sum = 0;
+    for (int i = 0; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+template <typename T>
+static void axpyScalar(T alpha, const T* x, T* y, int n) {
+    for (int i = 0; i < n; ++i) y[i] += alpha * x[i];
+}
+
+template <typename T>
+static void reluScalar(T* x, int n) {
+    for (int i = 0; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+template <typename T>
+static void reluMaskScalar(const T* activations, T* deltas, int n) {
+    for (int i = 0; i < n; ++i) if (activations[i] <= 0) deltas[i] = 0;
+}
+
+// arithmetic runs in the moment type M, parameters are rounded back to T
+template <typename T, typename M>
+static void adamUpdateScalar(T* params, M* m, M* v, T* g, int n, const AdamStepParams& s) {
+    const M b1 = static_cast<M>(s.beta_one), b2 = static_cast<M>(s.beta_two);
+    const M c1 = static_cast<M>(s.inv_correction_one), c2 = static_cast<M>(s.inv_correction_two);
+    const M lr = static_cast<M>(s.learning_rate), eps = static_cast<M>(s.epsilon);
+    for (int i = 0; i < n; ++i) {
+        M grad = g[i];
+        g[i] = 0;
+        m[i] = m[i] * b1 + (1 - b1) * grad;
+        v[i] = v[i] * b2 + (1 - b2) * grad * grad;
+        M corrected_m = m[i] * c1;
+        M corrected_v = v[i] * c2;
+        params[i] = static_cast<T>(params[i] - lr * corrected_m / (std::sqrt(corrected_v) + eps));
+    }
+}
+
+static const KernelTable<double> scalarKernelsDouble = {
+    "scalar", dotScalar<double>, axpyScalar<double>, reluScalar<double>, reluMaskScalar<double>,
+    adamUpdateScalar<double, double>, adamUpdateScalar<double, double>
+};
+
+static const KernelTable<float> scalarKernelsFloat = {
+    "scalar", dotScalar<float>, axpyScalar<float>, reluScalar<float>, reluMaskScalar<float>,
+    adamUpdateScalar<float, float>, adamUpdateScalar<float, double>
+};
+
+#ifdef RL_KERNELS_X86
+
+// ---------------------------------------------------------------- SSE2
+
+__attribute__((target("sse2")))
+static double dotSSE2(const double* a, const double* b, int n) {
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    acc0 = _mm_add_pd(acc0, acc1);
+    double sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("sse2")))
+static float dotSSE2(const float* a, const float* b, int n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    float sum = _mm_cvtss_f32(_mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1)));
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("sse2")))
+static void axpySSE2(double alpha, const double* x, double* y, int n) {
+    __m128d va = _mm_set1_pd(alpha);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+    }
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+__attribute__((target("sse2")))
+static void axpySSE2(float alpha, const float* x, float* y, int n) {
+    __m128 va = _mm_set1_ps(alpha);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    }
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+__attribute__((target("sse2")))
+static void reluSSE2(double* x, int n) {
+    __m128d zero = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(x + i, _mm_max_pd(_mm_loadu_pd(x + i), zero));
+    }
+    for (; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+__attribute__((target("sse2")))
+static void reluSSE2(float* x, int n) {
+    __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(x + i, _mm_max_ps(_mm_loadu_ps(x + i), zero));
+    }
+    for (; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+__attribute__((target("sse2")))
+static void reluMaskSSE2(const double* activations, double* deltas, int n) {
+    __m128d zero = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d keep = _mm_cmpgt_pd(_mm_loadu_pd(activations + i), zero);
+        _mm_storeu_pd(deltas + i, _mm_and_pd(keep, _mm_loadu_pd(deltas + i)));
+    }
+    for (; i < n; ++i) if (activations[i] <= 0.0) deltas[i] = 0.0;
+}
+
+__attribute__((target("sse2")))
+static void reluMaskSSE2(const float* activations, float* deltas, int n) {
+    __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 keep = _mm_cmpgt_ps(_mm_loadu_ps(activations + i), zero);
+        _mm_storeu_ps(deltas + i, _mm_and_ps(keep, _mm_loadu_ps(deltas + i)));
+    }
+    for (; i < n; ++i) if (activations[i] <= 0.0f) deltas[i] = 0.0f;
+}
+
+// one Adam step on two doubles, shared by the double and the widened float kernels
+__attribute__((target("sse2")))
+static inline __m128d adamStepSSE2(__m128d p, __m128d vg, double* m, double* v, const AdamStepParams& s) {
+    __m128d vm = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m), _mm_set1_pd(s.beta_one)), _mm_mul_pd(_mm_set1_pd(1 - s.beta_one), vg));
+    __m128d vv = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(v), _mm_set1_pd(s.beta_two)),
+                            _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(1 - s.beta_two), vg), vg));
+    _mm_storeu_pd(m, vm);
+    _mm_storeu_pd(v, vv);
+    __m128d denom = _mm_add_pd(_mm_sqrt_pd(_mm_mul_pd(vv, _mm_set1_pd(s.inv_correction_two))), _mm_set1_pd(s.epsilon));
+    __m128d step = _mm_div_pd(_mm_mul_pd(_mm_set1_pd(s.learning_rate), _mm_mul_pd(vm, _mm_set1_pd(s.inv_correction_one))), denom);
+    return _mm_sub_pd(p, step);
+}
+
+__attribute__((target("sse2")))
+static void adamUpdateSSE2(double* params, double* m, double* v, double* g, int n, const AdamStepParams& s) {
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(params + i, adamStepSSE2(_mm_loadu_pd(params + i), _mm_loadu_pd(g + i), m + i, v + i, s));
+        _mm_storeu_pd(g + i, _mm_setzero_pd());
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+__attribute__((target("sse2")))
+static void adamUpdateSSE2(float* params, float* m, float* v, float* g, int n, const AdamStepParams& s) {
+    __m128 b1 = _mm_set1_ps(static_cast<float>(s.beta_one)), b1c = _mm_set1_ps(static_cast<float>(1 - s.beta_one));
+    __m128 b2 = _mm_set1_ps(static_cast<float>(s.beta_two)), b2c = _mm_set1_ps(static_cast<float>(1 - s.beta_two));
+    __m128 c1 = _mm_set1_ps(static_cast<float>(s.inv_correction_one)), c2 = _mm_set1_ps(static_cast<float>(s.inv_correction_two));
+    __m128 lr = _mm_set1_ps(static_cast<float>(s.learning_rate)), eps = _mm_set1_ps(static_cast<float>(s.epsilon));
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 vg = _mm_loadu_ps(g + i);
+        _mm_storeu_ps(g + i, _mm_setzero_ps());
+        __m128 vm = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m + i), b1), _mm_mul_ps(b1c, vg));
+        __m128 vv = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v + i), b2), _mm_mul_ps(_mm_mul_ps(b2c, vg), vg));
+        _mm_storeu_ps(m + i, vm);
+        _mm_storeu_ps(v + i, vv);
+        __m128 denom = _mm_add_ps(_mm_sqrt_ps(_mm_mul_ps(vv, c2)), eps);
+        __m128 step = _mm_div_ps(_mm_mul_ps(lr, _mm_mul_ps(vm, c1)), denom);
+        _mm_storeu_ps(params + i, _mm_sub_ps(_mm_loadu_ps(params + i), step));
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+__attribute__((target("sse2")))
+static void adamUpdateWideSSE2(float* params, double* m, double* v, float* g, int n, const AdamStepParams& s) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 p4 = _mm_loadu_ps(params + i), g4 = _mm_loadu_ps(g + i);
+        _mm_storeu_ps(g + i, _mm_setzero_ps());
+        __m128d lo = adamStepSSE2(_mm_cvtps_pd(p4), _mm_cvtps_pd(g4), m + i, v + i, s);
+        __m128d hi = adamStepSSE2(_mm_cvtps_pd(_mm_movehl_ps(p4, p4)), _mm_cvtps_pd(_mm_movehl_ps(g4, g4)), m + i + 2, v + i + 2, s);
+        _mm_storeu_ps(params + i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+static const KernelTable<double> sse2KernelsDouble = {
+    "sse2", dotSSE2, axpySSE2, reluSSE2, reluMaskSSE2, adamUpdateSSE2, adamUpdateSSE2
+};
+
+static const KernelTable<float> sse2KernelsFloat = {
+    "sse2", dotSSE2, axpySSE2, reluSSE2, reluMaskSSE2, adamUpdateSSE2, adamUpdateWideSSE2
+};
+
+// ---------------------------------------------------------------- AVX2 + FMA
+
+__attribute__((target("avx2,fma")))
+static double dotAVX2(const double* a, const double* b, int n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static float dotAVX2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    float sum = _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpyAVX2(double alpha, const double* x, double* y, int n) {
+    __m256d va = _mm256_set1_pd(alpha);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    }
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void axpyAVX2(float alpha, const float* x, float* y, int n) {
+    __m256 va = _mm256_set1_ps(alpha);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void reluAVX2(double* x, int n) {
+    __m256d zero = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(x + i, _mm256_max_pd(_mm256_loadu_pd(x + i), zero));
+    }
+    for (; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+__attribute__((target("avx2,fma")))
+static void reluAVX2(float* x, int n) {
+    __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, _mm256_max_ps(_mm256_loadu_ps(x + i), zero));
+    }
+    for (; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+__attribute__((target("avx2,fma")))
+static void reluMaskAVX2(const double* activations, double* deltas, int n) {
+    __m256d zero = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d keep = _mm256_cmp_pd(_mm256_loadu_pd(activations + i), zero, _CMP_GT_OQ);
+        _mm256_storeu_pd(deltas + i, _mm256_and_pd(keep, _mm256_loadu_pd(deltas + i)));
+    }
+    for (; i < n; ++i) if (activations[i] <= 0.0) deltas[i] = 0.0;
+}
+
+__attribute__((target("avx2,fma")))
+static void reluMaskAVX2(const float* activations, float* deltas, int n) {
+    __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 keep = _mm256_cmp_ps(_mm256_loadu_ps(activations + i), zero, _CMP_GT_OQ);
+        _mm256_storeu_ps(deltas + i, _mm256_and_ps(keep, _mm256_loadu_ps(deltas + i)));
+    }
+    for (; i < n; ++i) if (activations[i] <= 0.0f) deltas[i] = 0.0f;
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256d adamStepAVX2(__m256d p, __m256d vg, double* m, double* v, const AdamStepParams& s) {
+    __m256d vm = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(m), _mm256_set1_pd(s.beta_one)),
+                               _mm256_mul_pd(_mm256_set1_pd(1 - s.beta_one), vg));
+    __m256d vv = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(v), _mm256_set1_pd(s.beta_two)),
+                               _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(1 - s.beta_two), vg), vg));
+    _mm256_storeu_pd(m, vm);
+    _mm256_storeu_pd(v, vv);
+    __m256d denom = _mm256_add_pd(_mm256_sqrt_pd(_mm256_mul_pd(vv, _mm256_set1_pd(s.inv_correction_two))),
+                                  _mm256_set1_pd(s.epsilon));
+    __m256d step = _mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(s.learning_rate),
+                                               _mm256_mul_pd(vm, _mm256_set1_pd(s.inv_correction_one))), denom);
+    return _mm256_sub_pd(p, step);
+}
+
+__attribute__((target("avx2,fma")))
+static void adamUpdateAVX2(double* params, double* m, double* v, double* g, int n, const AdamStepParams& s) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(params + i, adamStepAVX2(_mm256_loadu_pd(params + i), _mm256_loadu_pd(g + i), m + i, v + i, s));
+        _mm256_storeu_pd(g + i, _mm256_setzero_pd());
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+__attribute__((target("avx2,fma")))
+static void adamUpdateAVX2(float* params, float* m, float* v, float* g, int n, const AdamStepParams& s) {
+    __m256 b1 = _mm256_set1_ps(static_cast<float>(s.beta_one)), b1c = _mm256_set1_ps(static_cast<float>(1 - s.beta_one));
+    __m256 b2 = _mm256_set1_ps(static_cast<float>(s.beta_two)), b2c = _mm256_set1_ps(static_cast<float>(1 - s.beta_two));
+    __m256 c1 = _mm256_set1_ps(static_cast<float>(s.inv_correction_one)), c2 = _mm256_set1_ps(static_cast<float>(s.inv_correction_two));
+    __m256 lr = _mm256_set1_ps(static_cast<float>(s.learning_rate)), eps = _mm256_set1_ps(static_cast<float>(s.epsilon));
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vg = _mm256_loadu_ps(g + i);
+        _mm256_storeu_ps(g + i, _mm256_setzero_ps());
+        __m256 vm = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m + i), b1), _mm256_mul_ps(b1c, vg));
+        __m256 vv = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(v + i), b2), _mm256_mul_ps(_mm256_mul_ps(b2c, vg), vg));
+        _mm256_storeu_ps(m + i, vm);
+        _mm256_storeu_ps(v + i, vv);
+        __m256 denom = _mm256_add_ps(_mm256_sqrt_ps(_mm256_mul_ps(vv, c2)), eps);
+        __m256 step = _mm256_div_ps(_mm256_mul_ps(lr, _mm256_mul_ps(vm, c1)), denom);
+        _mm256_storeu_ps(params + i, _mm256_sub_ps(_mm256_loadu_ps(params + i), step));
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+__attribute__((target("avx2,fma")))
+static void adamUpdateWideAVX2(float* params, double* m, double* v, float* g, int n, const AdamStepParams& s) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d p = adamStepAVX2(_mm256_cvtps_pd(_mm_loadu_ps(params + i)), _mm256_cvtps_pd(_mm_loadu_ps(g + i)), m + i, v + i, s);
+        _mm_storeu_ps(g + i, _mm_setzero_ps());
+        _mm_storeu_ps(params + i, _mm256_cvtpd_ps(p));
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+static const KernelTable<double> avx2KernelsDouble = {
+    "avx2", dotAVX2, axpyAVX2, reluAVX2, reluMaskAVX2, adamUpdateAVX2, adamUpdateAVX2
+};
+
+static const KernelTable<float> avx2KernelsFloat = {
+    "avx2", dotAVX2, axpyAVX2, reluAVX2, reluMaskAVX2, adamUpdateAVX2, adamUpdateWideAVX2
+};
+
+// ---------------------------------------------------------------- AVX-512
+
+// GCC 12 flags the _mm512_undefined_pd() placeholders inside its own intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static double dotAVX512(const double* a, const double* b, int n) {
+    __m512d acc = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc);
+    }
+    if (i < n) {
+        __mmask8 tail = static_cast<__mmask8>((1u << (n - i)) - 1);
+        acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i), acc);
+    }
+    return _mm512_reduce_add_pd(acc);
+}
+
+__attribute__((target("avx512f")))
+static float dotAVX512(const float* a, const float* b, int n) {
+    __m512 acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+    }
+    if (i < n) {
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a + i), _mm512_maskz_loadu_ps(tail, b + i), acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+static void axpyAVX512(double alpha, const double* x, double* y, int n) {
+    __m512d va = _mm512_set1_pd(alpha);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+    }
+    if (i < n) {
+        __mmask8 tail = static_cast<__mmask8>((1u << (n - i)) - 1);
+        __m512d r = _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(tail, x + i), _mm512_maskz_loadu_pd(tail, y + i));
+        _mm512_mask_storeu_pd(y + i, tail, r);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void axpyAVX512(float alpha, const float* x, float* y, int n) {
+    __m512 va = _mm512_set1_ps(alpha);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    }
+    if (i < n) {
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        __m512 r = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(tail, x + i), _mm512_maskz_loadu_ps(tail, y + i));
+        _mm512_mask_storeu_ps(y + i, tail, r);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void reluAVX512(double* x, int n) {
+    __m512d zero = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(x + i, _mm512_max_pd(_mm512_loadu_pd(x + i), zero));
+    }
+    for (; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+__attribute__((target("avx512f")))
+static void reluAVX512(float* x, int n) {
+    __m512 zero = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(x + i, _mm512_max_ps(_mm512_loadu_ps(x + i), zero));
+    }
+    for (; i < n; ++i) if (x[i] < 0) x[i] = 0;
+}
+
+__attribute__((target("avx512f")))
+static void reluMaskAVX512(const double* activations, double* deltas, int n) {
+    __m512d zero = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __mmask8 keep = _mm512_cmp_pd_mask(_mm512_loadu_pd(activations + i), zero, _CMP_GT_OQ);
+        _mm512_storeu_pd(deltas + i, _mm512_maskz_mov_pd(keep, _mm512_loadu_pd(deltas + i)));
+    }
+    for (; i < n; ++i) if (activations[i] <= 0.0) deltas[i] = 0.0;
+}
+
+__attribute__((target("avx512f")))
+static void reluMaskAVX512(const float* activations, float* deltas, int n) {
+    __m512 zero = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 keep = _mm512_cmp_ps_mask(_mm512_loadu_ps(activations + i), zero, _CMP_GT_OQ);
+        _mm512_storeu_ps(deltas + i, _mm512_maskz_mov_ps(keep, _mm512_loadu_ps(deltas + i)));
+    }
+    for (; i < n; ++i) if (activations[i] <= 0.0f) deltas[i] = 0.0f;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d adamStepAVX512(__m512d p, __m512d vg, double* m, double* v, const AdamStepParams& s) {
+    __m512d vm = _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(m), _mm512_set1_pd(s.beta_one)),
+                               _mm512_mul_pd(_mm512_set1_pd(1 - s.beta_one), vg));
+    __m512d vv = _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(v), _mm512_set1_pd(s.beta_two)),
+                               _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(1 - s.beta_two), vg), vg));
+    _mm512_storeu_pd(m, vm);
+    _mm512_storeu_pd(v, vv);
+    __m512d denom = _mm512_add_pd(_mm512_sqrt_pd(_mm512_mul_pd(vv, _mm512_set1_pd(s.inv_correction_two))),
+                                  _mm512_set1_pd(s.epsilon));
+    __m512d step = _mm512_div_pd(_mm512_mul_pd(_mm512_set1_pd(s.learning_rate),
+                                               _mm512_mul_pd(vm, _mm512_set1_pd(s.inv_correction_one))), denom);
+    return _mm512_sub_pd(p, step);
+}
+
+__attribute__((target("avx512f")))
+static void adamUpdateAVX512(double* params, double* m, double* v, double* g, int n, const AdamStepParams& s) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(params + i, adamStepAVX512(_mm512_loadu_pd(params + i), _mm512_loadu_pd(g + i), m + i, v + i, s));
+        _mm512_storeu_pd(g + i, _mm512_setzero_pd());
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+__attribute__((target("avx512f")))
+static void adamUpdateAVX512(float* params, float* m, float* v, float* g, int n, const AdamStepParams& s) {
+    __m512 b1 = _mm512_set1_ps(static_cast<float>(s.beta_one)), b1c = _mm512_set1_ps(static_cast<float>(1 - s.beta_one));
+    __m512 b2 = _mm512_set1_ps(static_cast<float>(s.beta_two)), b2c = _mm512_set1_ps(static_cast<float>(1 - s.beta_two));
+    __m512 c1 = _mm512_set1_ps(static_cast<float>(s.inv_correction_one)), c2 = _mm512_set1_ps(static_cast<float>(s.inv_correction_two));
+    __m512 lr = _mm512_set1_ps(static_cast<float>(s.learning_rate)), eps = _mm512_set1_ps(static_cast<float>(s.epsilon));
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 vg = _mm512_loadu_ps(g + i);
+        _mm512_storeu_ps(g + i, _mm512_setzero_ps());
+        __m512 vm = _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(m + i), b1), _mm512_mul_ps(b1c, vg));
+        __m512 vv = _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(v + i), b2), _mm512_mul_ps(_mm512_mul_ps(b2c, vg), vg));
+        _mm512_storeu_ps(m + i, vm);
+        _mm512_storeu_ps(v + i, vv);
+        __m512 denom = _mm512_add_ps(_mm512_sqrt_ps(_mm512_mul_ps(vv, c2)), eps);
+        __m512 step = _mm512_div_ps(_mm512_mul_ps(lr, _mm512_mul_ps(vm, c1)), denom);
+        _mm512_storeu_ps(params + i, _mm512_sub_ps(_mm512_loadu_ps(params + i), step));
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+__attribute__((target("avx512f")))
+static void adamUpdateWideAVX512(float* params, double* m, double* v, float* g, int n, const AdamStepParams& s) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d p = adamStepAVX512(_mm512_cvtps_pd(_mm256_loadu_ps(params + i)), _mm512_cvtps_pd(_mm256_loadu_ps(g + i)), m + i, v + i, s);
+        _mm256_storeu_ps(g + i, _mm256_setzero_ps());
+        _mm256_storeu_ps(params + i, _mm512_cvtpd_ps(p));
+    }
+    adamUpdateScalar(params + i, m + i, v + i, g + i, n - i, s);
+}
+
+static const KernelTable<double> avx512KernelsDouble = {
+    "avx512", dotAVX512, axpyAVX512, reluAVX512, reluMaskAVX512, adamUpdateAVX512, adamUpdateAVX512
+};
+
+static const KernelTable<float> avx512KernelsFloat = {
+    "avx512", dotAVX512, axpyAVX512, reluAVX512, reluMaskAVX512, adamUpdateAVX512, adamUpdateWideAVX512
+};
+
+#pragma GCC diagnostic pop
+
+#endif // RL_KERNELS_X86
+
+// ---------------------------------------------------------------- dispatch
+
+template <typename T>
+struct KernelVariants;
+
+template <>
+struct KernelVariants<double> {
+    static const KernelTable<double>& scalar() { return scalarKernelsDouble; }
+#ifdef RL_KERNELS_X86
+    static const KernelTable<double>& sse2() { return sse2KernelsDouble; }
+    static const KernelTable<double>& avx2() { return avx2KernelsDouble; }
+    static const KernelTable<double>& avx512() { return avx512KernelsDouble; }
+#endif
+};
+
+template <>
+struct KernelVariants<float> {
+    static const KernelTable<float>& scalar() { return scalarKernelsFloat; }
+#ifdef RL_KERNELS_X86
+    static const KernelTable<float>& sse2() { return sse2KernelsFloat; }
+    static const KernelTable<float>& avx2() { return avx2KernelsFloat; }
+    static const KernelTable<float>& avx512() { return avx512KernelsFloat; }
+#endif
+};
+
+// variants this CPU can execute, widest first, scalar always last
+template <typename T>
+static std::vector<const KernelTable<T>*> supportedKernels() {
+    std::vector<const KernelTable<T>*> tables;
+#ifdef RL_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) tables.push_back(&KernelVariants<T>::avx512());
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) tables.push_back(&KernelVariants<T>::avx2());
+    if (__builtin_cpu_supports("sse2")) tables.push_back(&KernelVariants<T>::sse2());
+#endif
+    tables.push_back(&KernelVariants<T>::scalar());
+    return tables;
+}
+
+template <typename T>
+static const KernelTable<T>* selectKernels() {
+    std::vector<const KernelTable<T>*> tables = supportedKernels<T>();
+    if (const char* forced = std::getenv("RL_KERNELS")) {
+        for (const KernelTable<T>* table : tables) {
+            if (std::strcmp(table->name, forced) == 0) return table;
+        }
+        LOG_WARN("RL_KERNELS=" << forced << " is not supported on this CPU, using " << tables.front()->name);
+    }
+    return tables.front();
+}
+
+template <typename T>
+const KernelTable<T>& kernels() {
+    static const KernelTable<T>* selected = selectKernels<T>();
+    return *selected;
+}
+
+template const KernelTable<double>& kernels<double>();
+template const KernelTable<float>& kernels<float>();
+
+// relative tolerance per precision, FMA variants round differently from the scalar code
+template <typename T>
+static bool closeEnough(double expected, double actual) {
+    const double tolerance = sizeof(T) == sizeof(double) ? 1e-12 : 1e-5;
+    return std::fabs(expected - actual) <= tolerance * std::max(1.0, std::fabs(expected));
+}
+
+template <typename T>
+static bool selfTestPrecision(const char* precision) {
+    std::mt19937 gen(1234);
+    std::normal_distribution<double> dist(0.0, 1.0);
+
+    bool allPassed = true;
+    // odd length so every variant also runs its remainder loop
+    const int n = 131;
+    const KernelTable<T>& ref = KernelVariants<T>::scalar();
+
+    for (const KernelTable<T>* table : supportedKernels<T>()) {
+        if (table == &ref) continue;
+
+        std::vector<T> a(n), b(n), grads(n);
+        for (int i = 0; i < n; ++i) {
+            a[i] = static_cast<T>(dist(gen));
+            b[i] = static_cast<T>(dist(gen));
+            grads[i] = static_cast<T>(dist(gen) * 1e-3);
+        }
+
+        bool passed = closeEnough<T>(ref.dot(a.data(), b.data(), n), table->dot(a.data(), b.data(), n));
+
+        std::vector<T> yRef(b), yVec(b);
+        ref.axpy(static_cast<T>(0.37), a.data(), yRef.data(), n);
+        table->axpy(static_cast<T>(0.37), a.data(), yVec.data(), n);
+
+        std::vector<T> reluRef(a), reluVec(a);
+        ref.relu(reluRef.data(), n);
+        table->relu(reluVec.data(), n);
+
+        std::vector<T> maskRef(b), maskVec(b);
+        ref.reluMask(a.data(), maskRef.data(), n);
+        table->reluMask(a.data(), maskVec.data(), n);
+
+        AdamStepParams step = {0.9, 0.999, 0.001, 1.0 / (1 - 0.9 * 0.9), 1.0 / (1 - 0.999 * 0.999), 1e-8};
+        std::vector<T> pRef(a), mRef(n, static_cast<T>(0.01)), vRef(n, static_cast<T>(0.02));
+        std::vector<T> pVec(a), mVec(n, static_cast<T>(0.01)), vVec(n, static_cast<T>(0.02));
+        // the update consumes (zeroes) its gradients, every call gets its own copy
+        std::vector<T> gRef(grads), gVec(grads), gWideRef(grads), gWideVec(grads);
+        ref.adamUpdate(pRef.data(), mRef.data(), vRef.data(), gRef.data(), n, step);
+        table->adamUpdate(pVec.data(), mVec.data(), vVec.data(), gVec.data(), n, step);
+
+        std::vector<T> pWideRef(a), pWideVec(a);
+        std::vector<double> mWideRef(n, 0.01), vWideRef(n, 0.02), mWideVec(n, 0.01), vWideVec(n, 0.02);
+        ref.adamUpdateWide(pWideRef.data(), mWideRef.data(), vWideRef.data(), gWideRef.data(), n, step);
+        table->adamUpdateWide(pWideVec.data(), mWideVec.data(), vWideVec.data(), gWideVec.data(), n, step);
+
+        for (int i = 0; i < n; ++i) {
+            passed = passed && closeEnough<T>(yRef[i], yVec[i]) && reluRef[i] == reluVec[i] && maskRef[i] == maskVec[i]
+                && closeEnough<T>(pRef[i], pVec[i]) && closeEnough<T>(mRef[i], mVec[i]) && closeEnough<T>(vRef[i], vVec[i])
+                && closeEnough<T>(pWideRef[i], pWideVec[i]) && closeEnough<double>(mWideRef[i], mWideVec[i])
+                && closeEnough<double>(vWideRef[i], vWideVec[i]) && gVec[i] == 0 && gWideVec[i] == 0;
+        }
+
+        if (!passed) {
+            LOG_ERROR("Kernel self-test failed for " << table->name << " " << precision << " variant");
+            allPassed = false;
+        }
+    }
+
+    return allPassed;
+}
+
+bool kernelSelfTest() {
+    bool doublePassed = selfTestPrecision<double>("double");
+    bool floatPassed = selfTestPrecision<float>("float");
+    return doublePassed && floatPassed;
+}
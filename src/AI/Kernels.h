@@ -0,0 +1,37 @@
+#pragma once
+
+// Vector primitives used by the layer and optimizer inner loops.
+// The widest instruction set supported by the CPU is picked on first use,
+// falling back to the scalar versions on other architectures.
+
+struct AdamStepParams {
+    double beta_one;
+    double beta_two;
+    double learning_rate;
+    double inv_correction_one; // 1 / (1 - beta_one^t)
+    double inv_correction_two; // 1 / (1 - beta_two^t)
+    double epsilon;
+};
+
+template <typename T>
+struct KernelTable {
+    const char* name;
+    T (*dot)(const T* a, const T* b, int n);                                 // sum a[i] * b[i]
+    void (*axpy)(T alpha, const T* x, T* y, int n);                          // y += alpha * x
+    void (*relu)(T* x, int n);                                               // x = max(x, 0)
+    void (*reluMask)(const T* activations, T* deltas, int n);                // deltas = 0 where activations <= 0
+    // fused Adam step: moments, bias-corrected update, and grads reset to zero in the same pass
+    void (*adamUpdate)(T* params, T* first_moment, T* second_moment,
+                       T* grads, int n, const AdamStepParams& step);
+    // same update with the moments (and the arithmetic) kept in double
+    void (*adamUpdateWide)(T* params, double* first_moment, double* second_moment,
+                           T* grads, int n, const AdamStepParams& step);
+};
+
+// Dispatched table for float or double, the RL_KERNELS environment variable
+// (scalar, sse2, avx2, avx512) can force a variant
+template <typename T>
+const KernelTable<T>& kernels();
+
+// Compares every variant this CPU can run against the scalar reference, in both precisions
+bool kernelSelfTest();
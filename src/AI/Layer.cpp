@@ -1,36 +1,71 @@
 #include "Layer.h"
+#include "Gemm.h"
+#include "Kernels.h"
+#include "../Log.h"
+
+template <typename Scalar>
+void denseForward(const Scalar* in, int batchSize, const Scalar* weights, const Scalar* biases,
+                  int n_in, int n_out, bool linear, Scalar* out) {
+    for (int b = 0; b < batchSize; ++b) {
+        std::copy(biases, biases + n_out, out + static_cast<size_t>(b) * n_out);
+    }
+
+    gemmNN(batchSize, n_out, n_in, in, n_in, weights, n_out, out, n_out);
+
+    if (!linear) {
+        kernels<Scalar>().relu(out, batchSize * n_out);
+    }
+}
 
-Layer::Layer(int n_in, int n_out, int idx, bool isOut) {
+template <typename Scalar, typename MomentScalar>
+LayerT<Scalar, MomentScalar>::LayerT(int n_in, int n_out, int idx, bool isOut, Arena& arena, size_t offset) {
     n_inputs  = n_in;
     n_outputs = n_out;
     this->isOut = isOut;
     layer_idx = idx;
+    arena_offset = offset;
     output.resize(n_outputs);
     input.resize(n_inputs);
 
-    biases.resize(n_outputs);
-    grad_biases.resize(n_outputs);
-    std::fill(biases.begin(), biases.end(), 0); 
-
     node_values.resize(n_outputs);
 
-    optimizer = AdamOptimizer(n_inputs, n_outputs, 0.9, 0.999, 1e-8, 0.001, layer_idx);
+    optimizer = AdamOptimizerT<Scalar, MomentScalar>(n_inputs, n_outputs, 0.9, 0.999, 1e-8, 0.001, layer_idx);
+    bind(arena);
 
+    // the arena starts zeroed, so biases, gradients and moments are already 0
     std::random_device rd;
     std::default_random_engine generator(rd());
     std::normal_distribution<double> distribution(0, sqrt(2/(double)n_inputs));
-    weights.resize(n_inputs);
-    grad_weights.resize(n_inputs);
     for(int i = 0; i < n_inputs; i++) {
-        weights[i].resize(n_outputs);
-        grad_weights[i].resize(n_outputs);
         for(int j = 0; j < n_outputs; j++) {
-            weights[i][j] = distribution(generator);
+            weights[i * n_outputs + j] = static_cast<Scalar>(distribution(generator));
         }
     }
 }
 
-Layer::Layer(const Layer& other)
+template <typename Scalar, typename MomentScalar>
+size_t LayerT<Scalar, MomentScalar>::arenaSize(int n_in, int n_out) {
+    return Arena::padded(static_cast<size_t>(n_in) * n_out) + Arena::padded(n_out);
+}
+
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::bind(Arena& arena) {
+    const size_t w = arena_offset;
+    const size_t b = arena_offset + Arena::padded(static_cast<size_t>(n_inputs) * n_outputs);
+    const size_t n_weights = static_cast<size_t>(n_inputs) * n_outputs;
+
+    weights = ParamSpan<Scalar>(arena.params.data() + w, n_weights);
+    biases = ParamSpan<Scalar>(arena.params.data() + b, n_outputs);
+    grad_weights = ParamSpan<Scalar>(arena.grads.data() + w, n_weights);
+    grad_biases = ParamSpan<Scalar>(arena.grads.data() + b, n_outputs);
+    optimizer.bind(ParamSpan<MomentScalar>(arena.first_moment.data() + w, n_weights),
+                   ParamSpan<MomentScalar>(arena.second_moment.data() + w, n_weights),
+                   ParamSpan<MomentScalar>(arena.first_moment.data() + b, n_outputs),
+                   ParamSpan<MomentScalar>(arena.second_moment.data() + b, n_outputs));
+}
+
+template <typename Scalar, typename MomentScalar>
+LayerT<Scalar, MomentScalar>::LayerT(const LayerT& other)
     : weights(other.weights),          
       biases(other.biases),            
       grad_weights(other.grad_weights),
@@ -40,13 +75,16 @@ Layer::Layer(const Layer& other)
       n_outputs(other.n_outputs),      
       layer_idx(other.layer_idx),      
       isOut(other.isOut),              
+      arena_offset(other.arena_offset),
       input(other.input),              
       output(other.output),            
-      node_values(other.node_values)   
+      node_values(other.node_values),
+      batch_output(other.batch_output)
 {}
 
 //  copy operator for target network
-Layer& Layer::operator=(const Layer& other) {
+template <typename Scalar, typename MomentScalar>
+LayerT<Scalar, MomentScalar>& LayerT<Scalar, MomentScalar>::operator=(const LayerT& other) {
     if (this != &other) {
         weights = other.weights;
         biases = other.biases;
@@ -58,50 +96,47 @@ Layer& Layer::operator=(const Layer& other) {
         n_outputs = other.n_outputs;
         layer_idx = other.layer_idx;
         isOut = other.isOut;
+        arena_offset = other.arena_offset;
 
         input = other.input;
         output = other.output;
         node_values = other.node_values;
+        batch_output = other.batch_output;
     }
     return *this;
 }
 
-std::vector<double> Layer::forward(const std::vector<double>& in) {
+template <typename Scalar, typename MomentScalar>
+std::vector<Scalar> LayerT<Scalar, MomentScalar>::forward(const std::vector<Scalar>& in) {
             
     input = in;
-    std::fill(output.begin(), output.end(), 0.0);
 
+    const KernelTable<Scalar>& k = kernels<Scalar>();
+    std::copy(biases.begin(), biases.end(), output.begin());
     for(int i = 0; i < static_cast<int>(input.size()); i++) {
-        for(int j = 0; j < static_cast<int>(output.size()); j++) {
-            output[j] += input[i] * weights[i][j];   
-        }
-    }
-
-    for(int i = 0; i < n_outputs; i++) {
-        output[i] += biases[i];
+        k.axpy(input[i], &weights[i * n_outputs], output.data(), n_outputs);
     }
 
     if(!isOut) {
-        for(double& n : output)  {
-            if (n < 0) n = 0; 
-        }
+        k.relu(output.data(), n_outputs);
     }
 
     return output;
 }
 
-void Layer::save(const std::string& path) {
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::save(const std::string& path) {
     std::ofstream outFile(path + "/layer" + std::to_string(layer_idx) + ".txt");
 
     if (!outFile.is_open()) {
-        std::cerr << "Could not open file for saving: " << path << "/layer" << layer_idx << ".txt" << std::endl;
+        LOG_ERROR("Could not open file for saving: " << path << "/layer" << layer_idx << ".txt");
         return;
     }
 
     // Save weights
     for (int i = 0; i < n_inputs; ++i) {
         for (int j = 0; j < n_outputs; ++j) {
-            outFile << weights[i][j] << " ";
+            outFile << weights[i * n_outputs + j] << " ";
         }
         outFile << "\n";
     }
@@ -113,100 +148,107 @@ void Layer::save(const std::string& path) {
     outFile << "\n";
 
     outFile.close();
-    std::cout << "Layer " << layer_idx << " saved successfully to " << path << "\n";
+    LOG_DEBUG("Layer " << layer_idx << " saved successfully to " << path);
 
     optimizer.save(path);
 }
 
-void Layer::load(const std::string& path) {
+template <typename Scalar, typename MomentScalar>
+bool LayerT<Scalar, MomentScalar>::load(const std::string& path) {
     std::ifstream inFile(path + "/layer" + std::to_string(layer_idx) + ".txt");
 
     if (!inFile.is_open()) {
-        std::cerr << "Could not open file for loading: " << path << "/layer" << layer_idx << ".txt" << std::endl;
-        return;
+        LOG_WARN("Could not open file for loading: " << path << "/layer" << layer_idx << ".txt");
+        return false;
     }
 
     std::string line;
-    weights.resize(n_inputs);
     for (int i = 0; i < n_inputs; ++i) {
-        weights[i].resize(n_outputs);
         if (!std::getline(inFile, line)) {
-            std::cerr << "Error: Failed to read weights row " << i << std::endl;
-            return;
+            LOG_ERROR("Error: Failed to read weights row " << i);
+            return false;
         }
 
         std::istringstream iss(line);
         for (int j = 0; j < n_outputs; ++j) {
-            if (!(iss >> weights[i][j])) {
-                std::cerr << "Error: Failed to read weight [" << i << "][" << j << "]" << std::endl;
-                return;
+            if (!(iss >> weights[i * n_outputs + j])) {
+                LOG_ERROR("Error: Failed to read weight [" << i << "][" << j << "]");
+                return false;
             }
         }
+        Scalar extra;
+        if (iss >> extra) {
+            LOG_ERROR("Error: Weights row " << i << " has more than " << n_outputs << " values");
+            return false;
+        }
     }
 
     if (!std::getline(inFile, line)) {
-        std::cerr << "Error: Missing biases line in file." << std::endl;
-        return;
+        LOG_ERROR("Error: Missing biases line in file.");
+        return false;
     }
 
     std::istringstream biasStream(line);
     for (int j = 0; j < n_outputs; ++j) {
         if (!(biasStream >> biases[j])) {
-            std::cerr << "Error: Failed to read bias[" << j << "]" << std::endl;
-            return;
+            LOG_ERROR("Error: Failed to read bias[" << j << "]");
+            return false;
         }
     }
+    Scalar extra;
+    if (biasStream >> extra || (std::getline(inFile, line) && line.find_first_not_of(" \t\r") != std::string::npos)) {
+        LOG_ERROR("Error: Layer " << layer_idx << " file does not hold a " << n_inputs << "x" << n_outputs << " layer");
+        return false;
+    }
 
     inFile.close();
-    std::cout << "Successfully loaded layer " << layer_idx << " from file.\n";
+    LOG_DEBUG("Successfully loaded layer " << layer_idx << " from file.");
 
-    optimizer.load(path);
+    return optimizer.load(path);
 }
 
 
 
 
-void Layer::reset() {
-    for (auto& row : grad_weights) {
-        std::fill(row.begin(), row.end(), 0.0);
-    }
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::reset() {
+    std::fill(grad_weights.begin(), grad_weights.end(), 0.0);
     std::fill(grad_biases.begin(), grad_biases.end(), 0.0);
 }
 
-std::vector<double> Layer::backward(const std::vector<double>& dLoss_dOutput) {
-    std::vector<double> dLoss_dInput(n_inputs, 0.0);
+template <typename Scalar, typename MomentScalar>
+std::vector<Scalar> LayerT<Scalar, MomentScalar>::backward(const std::vector<Scalar>& dLoss_dOutput) {
+    std::vector<Scalar> dLoss_dInput(n_inputs, 0);
 
     for (int i = 0; i < n_outputs; i++) {
-        double delta = dLoss_dOutput[i];
+        Scalar delta = dLoss_dOutput[i];
         if (!isOut && output[i] <= 0) {
             delta = 0;
         }
         grad_biases[i] += delta;
 
         for (int j = 0; j < n_inputs; j++) {
-            grad_weights[j][i] += input[j] * delta;
-            dLoss_dInput[j] += weights[j][i] * delta;
+            grad_weights[j * n_outputs + i] += input[j] * delta;
+            dLoss_dInput[j] += weights[j * n_outputs + i] * delta;
         }
     }
 
     return dLoss_dInput;
 }
 
-void Layer::update() {
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::update() {
+    // gradients are cleared by the same pass that applies them
     optimizer.optimize(weights, biases, grad_weights, grad_biases);
-
-    // Clear gradients after applying them
-    for (auto& row : grad_weights) {
-        std::fill(row.begin(), row.end(), 0.0);
-    }
-    std::fill(grad_biases.begin(), grad_biases.end(), 0.0);
 }
 
-void Layer::setInput(const std::vector<double>& in) {
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::setInput(const std::vector<Scalar>& in) {
     input = in;
 }
 
-std::vector<double>& Layer::outputLayerNodeValues(double lossDerivative, int action) {
+template <typename Scalar, typename MomentScalar>
+std::vector<Scalar>& LayerT<Scalar, MomentScalar>::outputLayerNodeValues(Scalar lossDerivative, int action) {
     std::fill(node_values.begin(), node_values.end(), 0.0);
     if (action >= 0 && action < static_cast<int>(node_values.size())) {
         node_values[action] = lossDerivative;
@@ -214,42 +256,82 @@ std::vector<double>& Layer::outputLayerNodeValues(double lossDerivative, int act
         grad_biases[action] += node_values[action]; 
         
         for (int i = 0; i < n_inputs; ++i) {
-            grad_weights[i][action] += input[i] * node_values[action];
+            grad_weights[i * n_outputs + action] += input[i] * node_values[action];
         }
 
 
     } else {
-        std::cerr << "Invalid action index in outputLayerNodeValues: " << action << std::endl;
+        LOG_ERROR("Invalid action index in outputLayerNodeValues: " << action);
     }
     return node_values;
 }
 
-std::vector<double>& Layer::hiddenLayerNodeValues(const Layer& nextLayer, const std::vector<double>& nextLayerNodeValues) {
-    std::vector<double> activationDerivatives(output.size());
+template <typename Scalar, typename MomentScalar>
+std::vector<Scalar>& LayerT<Scalar, MomentScalar>::hiddenLayerNodeValues(const LayerT& nextLayer, const std::vector<Scalar>& nextLayerNodeValues) {
+    std::vector<Scalar> activationDerivatives(output.size());
     for (size_t i = 0; i < output.size(); ++i) {
         activationDerivatives[i] = (output[i] > 0.0) ? 1.0 : 0.0; // ReLU derivative
     }
 
+    const KernelTable<Scalar>& k = kernels<Scalar>();
     for (int i = 0; i < n_outputs; ++i) {
-        double sum = 0.0;
-        for (int j = 0; j < nextLayer.n_outputs; ++j) {
-            // Error propagated from the next layer multiplied by connection weight
-            sum += nextLayer.weights[i][j] * nextLayerNodeValues[j];
-        }
+        // Error propagated from the next layer multiplied by connection weight
+        Scalar sum = k.dot(&nextLayer.weights[i * nextLayer.n_outputs], nextLayerNodeValues.data(), nextLayer.n_outputs);
         node_values[i] = sum * activationDerivatives[i]; // Apply activation derivative
     }
 
-    for (int i = 0; i < n_outputs; ++i) { 
-        grad_biases[i] += node_values[i]; // Accumulate bias gradient
-
-        for (int j = 0; j < n_inputs; ++j) { 
-            // Accumulate weight gradient
-            grad_weights[j][i] += input[j] * node_values[i];
-        }
+    // Accumulate bias and weight gradients
+    k.axpy(1.0, node_values.data(), grad_biases.data(), n_outputs);
+    for (int j = 0; j < n_inputs; ++j) { 
+        k.axpy(input[j], node_values.data(), &grad_weights[j * n_outputs], n_outputs);
     }
 
     return node_values;
 }
 
+// out = relu(in * W + b) for the whole batch as one matrix product
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::forwardBatch(const Scalar* in, int batchSize) {
+    batch_output.resize(static_cast<size_t>(batchSize) * n_outputs);
+    forwardInto(in, batchSize, batch_output.data());
+}
+
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::forwardInto(const Scalar* in, int batchSize, Scalar* out) const {
+    denseForward(in, batchSize, weights.data(), biases.data(), n_inputs, n_outputs, isOut, out);
+}
+
+// deltas are dLoss/dz for this layer, prevDeltas (optional) receives deltas * W^T
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::backwardBatch(const Scalar* in, int batchSize, const Scalar* deltas, Scalar* prevDeltas) {
+    backwardInto(in, batchSize, deltas, prevDeltas, grad_weights.data(), grad_biases.data());
+}
+
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::backwardInto(const Scalar* in, int batchSize, const Scalar* deltas, Scalar* prevDeltas,
+                                                Scalar* gradWeights, Scalar* gradBiases) const {
+    gemmTN(n_inputs, n_outputs, batchSize, in, n_inputs, deltas, n_outputs, gradWeights, n_outputs);
+
+    const KernelTable<Scalar>& k = kernels<Scalar>();
+    for (int b = 0; b < batchSize; ++b) {
+        k.axpy(1.0, deltas + static_cast<size_t>(b) * n_outputs, gradBiases, n_outputs);
+    }
+
+    if (prevDeltas) {
+        std::fill(prevDeltas, prevDeltas + static_cast<size_t>(batchSize) * n_inputs, 0.0);
+        gemmNT(batchSize, n_inputs, n_outputs, deltas, n_outputs, weights.data(), n_outputs, prevDeltas, n_inputs);
+    }
+}
+
+// ReLU derivative of the last forwardBatch applied in place
+template <typename Scalar, typename MomentScalar>
+void LayerT<Scalar, MomentScalar>::reluBackward(Scalar* deltas, int batchSize) const {
+    kernels<Scalar>().reluMask(batch_output.data(), deltas, batchSize * n_outputs);
+}
 
+template void denseForward<double>(const double*, int, const double*, const double*, int, int, bool, double*);
+template void denseForward<float>(const float*, int, const float*, const float*, int, int, bool, float*);
 
+template class LayerT<double, double>;
+template class LayerT<float, float>;
+template class LayerT<float, double>;
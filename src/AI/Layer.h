@@ -3,44 +3,82 @@
 #include <vector>
 #include <string>
 #include <random>
+#include "AlignedAllocator.h"
 #include "Optimizer.h"
 
-class Layer {
+// out[batchSize x n_out] = in[batchSize x n_in] * weights + biases, ReLU unless `linear`.
+// Shared by every layer type that only needs inference.
+template <typename Scalar>
+void denseForward(const Scalar* in, int batchSize, const Scalar* weights, const Scalar* biases,
+                  int n_in, int n_out, bool linear, Scalar* out);
+
+template <typename Scalar, typename MomentScalar = Scalar>
+class LayerT {
 public:
-    // Constructors
-    Layer(int n_inputs, int n_outputs, int layer_idx, bool is_output);
-    Layer(const Layer& other);                      // Copy constructor
-    Layer& operator=(const Layer& other);           // Copy assignment
-    Layer clone() const;                           
+    using Arena = ParameterArena<Scalar, MomentScalar>;
+
+    // Constructors, parameters live in `arena` starting at element `offset`
+    LayerT(int n_inputs, int n_outputs, int layer_idx, bool is_output, Arena& arena, size_t offset);
+    LayerT(const LayerT& other);                      // Copy constructor, still viewing other's arena until bind()
+    LayerT& operator=(const LayerT& other);           // Copy assignment, same caveat
+
+    // arena elements taken by a layer of this shape, padding included
+    static size_t arenaSize(int n_inputs, int n_outputs);
+    // points the parameter, gradient and moment views at `arena`
+    void bind(Arena& arena);
+    LayerT clone() const;                           
 
     // Forward and backward passes
-    std::vector<double> forward(const std::vector<double>& input);
-    std::vector<double> backward(const std::vector<double>& dLoss_dOutput);
+    std::vector<Scalar> forward(const std::vector<Scalar>& input);
+    std::vector<Scalar> backward(const std::vector<Scalar>& dLoss_dOutput);
 
-    void setInput(const std::vector<double>& input);
-    std::vector<double>& outputLayerNodeValues(double lossDerivative, int action);
-    std::vector<double>& hiddenLayerNodeValues(const Layer& nextLayer, const std::vector<double>& nextLayerNodeValues);
+    void setInput(const std::vector<Scalar>& input);
+    std::vector<Scalar>& outputLayerNodeValues(Scalar lossDerivative, int action);
+    std::vector<Scalar>& hiddenLayerNodeValues(const LayerT& nextLayer, const std::vector<Scalar>& nextLayerNodeValues);
+
+    // Batched passes, rows of the [batchSize x n] matrices are samples
+    void forwardBatch(const Scalar* in, int batchSize);
+    // same pass without touching any member state, out holds [batchSize x n_outputs]
+    void forwardInto(const Scalar* in, int batchSize, Scalar* out) const;
+    void backwardBatch(const Scalar* in, int batchSize, const Scalar* deltas, Scalar* prevDeltas);
+    // same pass accumulating into caller-owned gradient buffers, laid out like grad_weights / grad_biases
+    void backwardInto(const Scalar* in, int batchSize, const Scalar* deltas, Scalar* prevDeltas,
+                      Scalar* gradWeights, Scalar* gradBiases) const;
+    void reluBackward(Scalar* deltas, int batchSize) const;
+    const Scalar* batchOutput() const { return batch_output.data(); }
+
+    int inputSize() const { return n_inputs; }
+    int outputSize() const { return n_outputs; }
+    int index() const { return layer_idx; }
+    size_t arenaOffset() const { return arena_offset; }
+    bool isOutput() const { return isOut; }
 
     void update();
     void reset();
 
     void save(const std::string& path);
-    void load(const std::string& path);
+    // false when the layer or its Adam state file is missing or malformed
+    bool load(const std::string& path);
 
-    std::vector<std::vector<double>> weights;
-    std::vector<double> biases;
-    std::vector<std::vector<double>> grad_weights;
-    std::vector<double> grad_biases;
+    // row-major [n_inputs x n_outputs], weights[i * n_outputs + j] connects input i to output j
+    ParamSpan<Scalar> weights;
+    ParamSpan<Scalar> biases;
+    ParamSpan<Scalar> grad_weights;
+    ParamSpan<Scalar> grad_biases;
 
-    AdamOptimizer optimizer;
+    AdamOptimizerT<Scalar, MomentScalar> optimizer;
 
 private:
     int n_inputs;
     int n_outputs;
     int layer_idx;
     bool isOut;
+    size_t arena_offset;
 
-    std::vector<double> input;
-    std::vector<double> output;
-    std::vector<double> node_values;
+    std::vector<Scalar> input;
+    std::vector<Scalar> output;
+    std::vector<Scalar> node_values;
+    AlignedVector<Scalar> batch_output;
 };
+
+using Layer = LayerT<net_scalar, moment_scalar>;
@@ -1,111 +1,377 @@
 #include "NeuralNetwork.h"
+#include "Checkpoint.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include "../Log.h"
+#include "../Profiler.h"
+#include <algorithm>
+#include <filesystem>
 
 
-NeuralNetwork::NeuralNetwork(std::vector<int> layerSizes, double eps, double lr, std::string p) {
+template <typename Scalar, typename MomentScalar>
+NeuralNetworkT<Scalar, MomentScalar>::NeuralNetworkT(std::vector<int> layerSizes, double eps, double lr, std::string p) {
 
     learnRate = lr;
     epsilon = eps;
     path = p;
 
+    std::vector<size_t> offsets;
+    size_t total = 0;
+    for(size_t i = 0; i < layerSizes.size() - 1; ++i) {
+        offsets.push_back(total);
+        total += LayerT<Scalar, MomentScalar>::arenaSize(layerSizes[i], layerSizes[i+1]);
+    }
+    arena.allocate(total);
+
     for(size_t i = 0; i < layerSizes.size() - 1; ++i) {
         int layer_type = (i == layerSizes.size() - 2) ? 1 : 0;
-        layers.push_back(Layer(layerSizes[i], layerSizes[i+1], i, layer_type));
+        layers.push_back(LayerT<Scalar, MomentScalar>(layerSizes[i], layerSizes[i+1], i, layer_type, arena, offsets[i]));
     }
     
-    load(path);
+    // a binary checkpoint next to (or instead of) the text directory takes precedence
+    if (std::filesystem::is_regular_file(path)) {
+        loadCheckpoint(path);
+    } else if (std::filesystem::is_regular_file(path + ".rlck")) {
+        loadCheckpoint(path + ".rlck");
+    } else {
+        load(path);
+    }
 
 }
 
-NeuralNetwork::NeuralNetwork(const NeuralNetwork& other)
-    : learnRate(other.learnRate),
+template <typename Scalar, typename MomentScalar>
+NeuralNetworkT<Scalar, MomentScalar>::NeuralNetworkT(const NeuralNetworkT& other)
+    : arena(other.arena),
+      learnRate(other.learnRate),
       epsilon(other.epsilon),
       path(other.path)
 {
     layers.clear();
-    for (const Layer& layer : other.layers) {
+    for (const auto& layer : other.layers) {
         layers.push_back(layer); // calls Layer copy constructor
+        layers.back().bind(arena);
     }
 }
 
-NeuralNetwork& NeuralNetwork::operator=(const NeuralNetwork& other) {
+template <typename Scalar, typename MomentScalar>
+NeuralNetworkT<Scalar, MomentScalar>& NeuralNetworkT<Scalar, MomentScalar>::operator=(const NeuralNetworkT& other) {
     if (this != &other) {
         learnRate = other.learnRate;
         epsilon = other.epsilon;
         path = other.path;
+        arena = other.arena;
 
         layers.clear();
-        for (const Layer& layer : other.layers) {
+        for (const auto& layer : other.layers) {
             layers.push_back(layer);
+            layers.back().bind(arena);
         }
     }
     return *this;
 }
 
 
-void NeuralNetwork::save(const std::string& path){
+template <typename Scalar, typename MomentScalar>
+void NeuralNetworkT<Scalar, MomentScalar>::save(const std::string& path){
 
-    std::cout << "Saving network to directory: " << path << std::endl;
+    LOG_INFO("Saving network to directory: " << path);
     for (size_t i = 0; i < layers.size(); ++i) {
-        layers[i].save(path);
-        if(typeid(layers[i].optimizer) == typeid(AdamOptimizer)) {
-            layers[i].optimizer.save(path);
-        }
+        layers[i].save(path); // also writes the layer's Adam state
     }
-    std::cout << "Network saved." << std::endl;
+    LOG_INFO("Network saved.");
 }
 
-void NeuralNetwork::load(const std::string& path) {
+template <typename Scalar, typename MomentScalar>
+bool NeuralNetworkT<Scalar, MomentScalar>::load(const std::string& path) {
 
-    std::cout << "Loading network from directory: " << path << std::endl;
+    LOG_INFO("Loading network from directory: " << path);
+    bool ok = true;
     for (size_t i = 0; i < layers.size(); ++i) {
-        layers[i].load(path);
-        if(typeid(layers[i].optimizer) == typeid(AdamOptimizer)) {
-            layers[i].optimizer.load(path);
+        ok = layers[i].load(path) && ok; // also reads the layer's Adam state
+    }
+    if (ok) LOG_INFO("Network loaded.");
+    return ok;
+}
+
+template <typename Scalar, typename MomentScalar>
+bool NeuralNetworkT<Scalar, MomentScalar>::saveCheckpoint(const std::string& file_path) const {
+    std::vector<CheckpointLayer> table;
+    for (const auto& layer : layers) {
+        const auto& opt = layer.optimizer;
+        table.push_back({layer.inputSize(), layer.outputSize(), layer.isOutput() ? 1 : 0, 0, opt.training_steps,
+                         opt.alpha, opt.beta_one, opt.beta_two, opt.epsilon_stable, opt.beta_one_power, opt.beta_two_power});
+    }
+
+    // the arena already has the file's section layout, each section is one block
+    CheckpointWriter writer;
+    bool ok = writer.begin(file_path, sizeof(Scalar), sizeof(MomentScalar), table)
+        && writer.beginSection() && writer.writeBlock(arena.params.data(), arena.size(), sizeof(Scalar))
+        && writer.beginSection() && writer.writeBlock(arena.first_moment.data(), arena.size(), sizeof(MomentScalar))
+        && writer.beginSection() && writer.writeBlock(arena.second_moment.data(), arena.size(), sizeof(MomentScalar))
+        && writer.finish();
+    if (ok) LOG_INFO("Network saved to " << file_path);
+    return ok;
+}
+
+template <typename Scalar, typename MomentScalar>
+bool NeuralNetworkT<Scalar, MomentScalar>::loadCheckpoint(const std::string& file_path) {
+    MappedCheckpoint checkpoint;
+    if (!checkpoint.open(file_path)) return false;
+
+    const CheckpointHeader& h = checkpoint.header();
+    bool shapesMatch = h.num_layers == layers.size();
+    for (size_t i = 0; shapesMatch && i < layers.size(); ++i) {
+        shapesMatch = checkpoint.layer(i).n_inputs == layers[i].inputSize() && checkpoint.layer(i).n_outputs == layers[i].outputSize();
+    }
+    if (!shapesMatch) {
+        LOG_ERROR("Error: layer sizes in " << file_path << " do not match the network");
+        return false;
+    }
+
+    // sections line up with the arena when the parameter type matches, otherwise convert layer by layer
+    auto readSection = [&](const void* section, size_t bytes, auto* arenaData) {
+        if (h.scalar_bytes == sizeof(Scalar)) {
+            checkpointReadElements(section, bytes, arenaData, arena.size());
+            return;
         }
+        const unsigned char* src = static_cast<const unsigned char*>(section);
+        for (size_t i = 0; i < layers.size(); ++i) {
+            const size_t nWeights = static_cast<size_t>(layers[i].inputSize()) * layers[i].outputSize();
+            const size_t fileWeights = checkpoint.weightsOffset(i);
+            const size_t fileBiases = fileWeights + checkpointPadded(nWeights, h.scalar_bytes);
+            const size_t arenaWeights = layers[i].weights.data() - arena.params.data();
+            const size_t arenaBiases = layers[i].biases.data() - arena.params.data();
+            checkpointReadElements(src + fileWeights * bytes, bytes, arenaData + arenaWeights, nWeights);
+            checkpointReadElements(src + fileBiases * bytes, bytes, arenaData + arenaBiases, layers[i].outputSize());
+        }
+    };
+
+    readSection(checkpoint.params(), h.scalar_bytes, arena.params.data());
+    if (checkpoint.hasMoments()) {
+        readSection(checkpoint.firstMoments(), h.moment_bytes, arena.first_moment.data());
+        readSection(checkpoint.secondMoments(), h.moment_bytes, arena.second_moment.data());
+        for (size_t i = 0; i < layers.size(); ++i) {
+            const CheckpointLayer& saved = checkpoint.layer(i);
+            auto& opt = layers[i].optimizer;
+            opt.training_steps = static_cast<int>(saved.training_steps);
+            opt.alpha = saved.alpha;
+            opt.beta_one = saved.beta_one;
+            opt.beta_two = saved.beta_two;
+            opt.epsilon_stable = saved.epsilon;
+            opt.beta_one_power = saved.beta_one_power;
+            opt.beta_two_power = saved.beta_two_power;
+        }
+    } else {
+        LOG_WARN(file_path << " has no optimizer state. Initializing new Adam configuration...");
     }
-    std::cout << "Network loaded." << std::endl;
+
+    LOG_INFO("Network loaded from " << file_path);
+    return true;
 }
 
-std::vector<double> NeuralNetwork::forward(const std::vector<double>& input) {
-    std::vector<double> current_output = input; 
-    for (auto& layer : layers) {
-        current_output = layer.forward(current_output); // Pass output of current layer as input to the next
+template <typename Scalar, typename MomentScalar>
+std::vector<Scalar> NeuralNetworkT<Scalar, MomentScalar>::forward(const std::vector<Scalar>& input) const {
+    return forwardBatch(input, 1);
+}
+
+template <typename Scalar, typename MomentScalar>
+const Scalar* NeuralNetworkT<Scalar, MomentScalar>::forward(const Scalar* inputs, int count, InferenceWorkspace<Scalar>& workspace) const {
+    const Scalar* activations = inputs;
+    for (const auto& layer : layers) {
+        size_t needed = static_cast<size_t>(count) * layer.outputSize();
+        if (workspace.next.size() < needed) workspace.next.resize(needed);
+        layer.forwardInto(activations, count, workspace.next.data());
+        // Pass output of current layer as input to the next
+        std::swap(workspace.current, workspace.next);
+        activations = workspace.current.data();
+    }
+    return activations;
+}
+
+template <typename Scalar, typename MomentScalar>
+InferenceWorkspace<Scalar>& NeuralNetworkT<Scalar, MomentScalar>::threadWorkspace() {
+    thread_local InferenceWorkspace<Scalar> workspace;
+    return workspace;
+}
+
+template <typename Scalar, typename MomentScalar>
+std::vector<Scalar> NeuralNetworkT<Scalar, MomentScalar>::forwardBatch(const std::vector<Scalar>& inputs, int count) const {
+    if (count <= 0) return {};
+    if (inputs.size() != static_cast<size_t>(count) * inputSize()) {
+        LOG_ERROR("Error: forwardBatch expected " << count * inputSize() << " inputs, got " << inputs.size());
+        return {};
     }
-    return current_output; 
+    const Scalar* q = forward(inputs.data(), count, threadWorkspace());
+    return std::vector<Scalar>(q, q + static_cast<size_t>(count) * outputSize());
 }
 
-void NeuralNetwork::learn(const std::vector<std::tuple<ReplayRecord, double>>& batch) {
+// rows per gradient shard of learn(). The shard count only depends on the batch size,
+// and a single thread runs the same shards and reduction one after another, so
+// results do not change with the number of cores.
+static const int LEARN_SHARD_ROWS = 16;
+// smallest slice of the arena worth handing to another thread during the reduction
+static const size_t REDUCE_MIN_CHUNK = 4096;
 
-    for(auto& layer : layers) {
-        layer.reset();
+template <typename Scalar, typename MomentScalar>
+void NeuralNetworkT<Scalar, MomentScalar>::learn(const std::vector<std::tuple<ReplayRecord, double>>& batch) {
+
+    const int batchSize = static_cast<int>(batch.size());
+    if (batchSize == 0) return;
+
+    const int nIn = layers.front().inputSize();
+    batch_input.resize(static_cast<size_t>(batchSize) * nIn);
+    batch_actions.resize(batchSize);
+    batch_targets.resize(batchSize);
+    for (int b = 0; b < batchSize; ++b) {
+        std::get<0>(batch[b]).state.writeFeatures(batch_input.data() + static_cast<size_t>(b) * nIn);
+        batch_actions[b] = static_cast<int>(std::get<0>(batch[b]).action);
+        batch_targets[b] = std::get<1>(batch[b]);
+    }
+    learn(batch_input.data(), batch_actions.data(), batch_targets.data(), batchSize);
+}
+
+// One minibatch step: each shard of the batch goes through the layers as a single matrix product
+template <typename Scalar, typename MomentScalar>
+void NeuralNetworkT<Scalar, MomentScalar>::learn(const Scalar* states, const int* actions, const double* targets,
+                                                 int batchSize, const double* weights, double* td_errors) {
+    if (batchSize == 0) return;
+
+    ThreadPool& pool = ThreadPool::shared();
+    const int numShards = (batchSize + LEARN_SHARD_ROWS - 1) / LEARN_SHARD_ROWS;
+    const int rowsPerShard = (batchSize + numShards - 1) / numShards;
+    if (static_cast<int>(shards.size()) < numShards) shards.resize(numShards);
+    for (int s = 1; s < numShards; ++s) {
+        if (shards[s].grads.size() != arena.size()) shards[s].grads.assign(arena.size(), 0);
+    }
+
+    {
+        PROFILE_SCOPE("backprop");
+        // gradients are already zero: applyGradients() and the reduction clear them as they consume them
+        pool.run(numShards, [&](int s) {
+            const int first = s * rowsPerShard;
+            const int rows = std::min(batchSize, first + rowsPerShard) - first;
+            if (rows <= 0) return;
+            Scalar* grads = s == 0 ? arena.grads.data() : shards[s].grads.data();
+            backpropagate(states, actions, targets, weights, td_errors, first, rows, shards[s], grads);
+        });
+
+        if (numShards > 1) {
+            reduceShardGradients(numShards);
+        }
     }
 
-    for(const auto& experience_tuple : batch) {
-        const auto& record = std::get<0>(experience_tuple);
-        double target_q_value = std::get<1>(experience_tuple);
-        const auto& input_state = record.state;
-        Action action_taken = record.action;
+    //Apply the accumulated gradients 
+    PROFILE_SCOPE("adam");
+    applyGradients();
+}
+
+template <typename Scalar, typename MomentScalar>
+void NeuralNetworkT<Scalar, MomentScalar>::backpropagate(const Scalar* states, const int* actions, const double* targets,
+                                                         const double* weights, double* td_errors,
+                                                         int first, int rows, LearnShard& shard, Scalar* grads) const {
+    const int numLayers = static_cast<int>(layers.size());
+    const Scalar* input = states + static_cast<size_t>(first) * layers.front().inputSize();
+    shard.activations.resize(numLayers);
+    shard.deltas.resize(numLayers);
 
-        std::vector<double> predicted_q_values = NeuralNetwork::forward(input_state.toVector());
+    const Scalar* activations = input;
+    for (int l = 0; l < numLayers; ++l) {
+        shard.activations[l].resize(static_cast<size_t>(rows) * layers[l].outputSize());
+        layers[l].forwardInto(activations, rows, shard.activations[l].data());
+        activations = shard.activations[l].data();
+    }
 
-        size_t action_idx = static_cast<size_t>(action_taken);
-        if (action_idx >= predicted_q_values.size()) {
-             std::cerr << "Error: Action index out of bounds!  size:  " << predicted_q_values.size() << "idx: " << action_idx<< std::endl;
+    // dLoss/dQ is only non-zero for the action taken in each sample
+    const int nOut = layers.back().outputSize();
+    AlignedVector<Scalar>& outDeltas = shard.deltas.back();
+    outDeltas.assign(static_cast<size_t>(rows) * nOut, 0.0);
+    for (int b = 0; b < rows; ++b) {
+        size_t action_idx = static_cast<size_t>(actions[first + b]);
+        if (action_idx >= static_cast<size_t>(nOut)) {
+             LOG_ERROR("Error: Action index out of bounds!  size:  " << nOut << "idx: " << action_idx);
+             if (td_errors) td_errors[first + b] = 0.0;
              continue;
         }
+        Scalar predicted_q_for_action = activations[b * nOut + action_idx];
+        Scalar delta = predicted_q_for_action - static_cast<Scalar>(targets[first + b]);
+        if (td_errors) td_errors[first + b] = delta;
+        if (weights) delta *= static_cast<Scalar>(weights[first + b]);
+        outDeltas[b * nOut + action_idx] = delta;
+    }
 
-        double predicted_q_for_action = predicted_q_values[action_idx];
-        double lossDerivative = predicted_q_for_action - target_q_value;
+    const Scalar* params = arena.params.data();
+    for (int layerIdx = numLayers - 1; layerIdx >= 0; --layerIdx) {
+        const auto& layer = layers[layerIdx];
+        const Scalar* layerInput = layerIdx == 0 ? input : shard.activations[layerIdx - 1].data();
+        Scalar* prevDeltas = nullptr;
+        if (layerIdx > 0) {
+            shard.deltas[layerIdx - 1].resize(static_cast<size_t>(rows) * layer.inputSize());
+            prevDeltas = shard.deltas[layerIdx - 1].data();
+        }
+        layer.backwardInto(layerInput, rows, shard.deltas[layerIdx].data(), prevDeltas,
+                           grads + (layer.weights.data() - params), grads + (layer.biases.data() - params));
+        if (prevDeltas) {
+            kernels<Scalar>().reluMask(shard.activations[layerIdx - 1].data(), prevDeltas, rows * layer.inputSize());
+        }
+    }
+}
 
-        std::vector<double> error_signals_to_propagate = layers.back().outputLayerNodeValues(lossDerivative, action_idx);
+template <typename Scalar, typename MomentScalar>
+void NeuralNetworkT<Scalar, MomentScalar>::reduceShardGradients(int numShards) {
+    ThreadPool& pool = ThreadPool::shared();
+    const size_t n = arena.size();
+    const int chunks = static_cast<int>(std::max<size_t>(1, std::min<size_t>(pool.size(), n / REDUCE_MIN_CHUNK)));
+    const size_t line = 64 / sizeof(Scalar);
+    const size_t chunk = (n / chunks + line - 1) / line * line;
+    const KernelTable<Scalar>& k = kernels<Scalar>();
 
-        for (int layerIdx = static_cast<int>(layers.size()) - 2; layerIdx >= 0; --layerIdx) {
-             error_signals_to_propagate = layers[layerIdx].hiddenLayerNodeValues(layers[layerIdx+1], error_signals_to_propagate);
+    // every element is summed in the same order whatever the chunking
+    pool.run(chunks, [&](int c) {
+        const size_t begin = std::min(n, c * chunk);
+        const size_t end = std::min(n, begin + chunk);
+        if (begin == end) return;
+        for (int stride = 1; stride < numShards; stride *= 2) {
+            for (int s = 0; s + stride < numShards; s += 2 * stride) {
+                Scalar* dst = s == 0 ? arena.grads.data() : shards[s].grads.data();
+                Scalar* src = shards[s + stride].grads.data();
+                k.axpy(1, src + begin, dst + begin, static_cast<int>(end - begin));
+                std::fill(src + begin, src + end, Scalar(0));
+            }
         }
-    } 
+    });
+}
 
-    //Apply the accumulated gradients 
-    for(auto& layer : layers) {
-        layer.update(); 
+template <typename Scalar, typename MomentScalar>
+void NeuralNetworkT<Scalar, MomentScalar>::applyGradients() {
+    std::vector<AdamStepParams> steps;
+    bool lockstep = true;
+    for (auto& layer : layers) {
+        steps.push_back(layer.optimizer.advance());
+        const AdamStepParams& a = steps.front();
+        const AdamStepParams& b = steps.back();
+        lockstep = lockstep && a.beta_one == b.beta_one && a.beta_two == b.beta_two && a.learning_rate == b.learning_rate
+            && a.inv_correction_one == b.inv_correction_one && a.inv_correction_two == b.inv_correction_two
+            && a.epsilon == b.epsilon;
+    }
+
+    // layers normally share hyperparameters and step count, so the whole arena is one sweep
+    if (lockstep) {
+        adamUpdateRange(arena.params.data(), arena.first_moment.data(), arena.second_moment.data(),
+                        arena.grads.data(), arena.size(), steps.front());
+        return;
+    }
+
+    // checkpoints whose layers disagree (e.g. different step counts) are stepped layer by layer
+    for (size_t i = 0; i < layers.size(); ++i) {
+        auto& layer = layers[i];
+        auto& opt = layer.optimizer;
+        adamUpdateRange(layer.weights.data(), opt.weight_first_moment.data(), opt.weight_second_moment.data(),
+                        layer.grad_weights.data(), layer.weights.size(), steps[i]);
+        adamUpdateRange(layer.biases.data(), opt.bias_first_moment.data(), opt.bias_second_moment.data(),
+                        layer.grad_biases.data(), layer.biases.size(), steps[i]);
     }
 }
+
+template class NeuralNetworkT<double, double>;
+template class NeuralNetworkT<float, float>;
+template class NeuralNetworkT<float, double>;
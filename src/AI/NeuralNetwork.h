@@ -1,24 +1,82 @@
+#pragma once
+
 #include <vector>
 #include <string>
 #include "Layer.h"
 #include "Optimizer.h"
 #include "State.h"
 
-class NeuralNetwork {
+// Activation buffers for the const inference path. Each thread (or caller)
+// owns one; they grow to the widest layer once and are then reused.
+template <typename Scalar>
+struct InferenceWorkspace {
+    AlignedVector<Scalar> current;
+    AlignedVector<Scalar> next;
+};
+
+// Q-network over Scalar activations/parameters, Adam moments in MomentScalar
+template <typename Scalar, typename MomentScalar = Scalar>
+class NeuralNetworkT {
     public:
-        NeuralNetwork(const NeuralNetwork& other); // Copy constructor
-        NeuralNetwork& operator=(const NeuralNetwork& other); // Copy assignment
-        NeuralNetwork(std::vector<int> layerSizes, double eps, double lr, std::string p);
-        std::vector<double> forward(const std::vector<double>& input) ;
-        void backward(const std::vector<double>& expected_output);
-        void trainStep(const std::vector<double>& input, const std::vector<double>& expected_output);
+        NeuralNetworkT(const NeuralNetworkT& other); // Copy constructor
+        NeuralNetworkT& operator=(const NeuralNetworkT& other); // Copy assignment
+        NeuralNetworkT(std::vector<int> layerSizes, double eps, double lr, std::string p);
+        std::vector<Scalar> forward(const std::vector<Scalar>& input) const;
+        // Q-values for `count` encoded states stored row by row, returned as a [count x outputs] matrix
+        std::vector<Scalar> forwardBatch(const std::vector<Scalar>& inputs, int count) const;
+        // Thread-safe, allocation-free inference: the returned [count x outputs] matrix
+        // lives in `workspace` and stays valid until its next use
+        const Scalar* forward(const Scalar* inputs, int count, InferenceWorkspace<Scalar>& workspace) const;
+        // workspace owned by the calling thread, shared by all networks of this scalar type
+        static InferenceWorkspace<Scalar>& threadWorkspace();
+        int inputSize() const { return layers.front().inputSize(); }
+        int outputSize() const { return layers.back().outputSize(); }
+        const std::vector<LayerT<Scalar, MomentScalar>>& getLayers() const { return layers; }
+        const ParameterArena<Scalar, MomentScalar>& parameters() const { return arena; }
+        void backward(const std::vector<Scalar>& expected_output);
+        void trainStep(const std::vector<Scalar>& input, const std::vector<Scalar>& expected_output);
         void learn(const std::vector<std::tuple<ReplayRecord, double>>& batch); 
+        // one minibatch step on `count` encoded states stored row by row: the Q-value of
+        // actions[b] in row b is moved towards targets[b], the other outputs get no gradient.
+        // Row b's gradient is scaled by weights[b] when given, and td_errors[b] receives
+        // Q - target from before the step.
+        void learn(const Scalar* states, const int* actions, const double* targets, int count,
+                   const double* weights = nullptr, double* td_errors = nullptr);
         void save(const std::string& directory_path);
-        void load(const std::string& directory_path);
+        // false unless every layer and its Adam state were read
+        bool load(const std::string& directory_path);
+        // binary .rlck checkpoint with the Adam state (see Checkpoint.h)
+        bool saveCheckpoint(const std::string& file_path) const;
+        bool loadCheckpoint(const std::string& file_path);
     private:
-        std::vector<Layer> layers;
+        // scratch of one learn() shard: activations and deltas of its rows, private gradients
+        struct LearnShard {
+            std::vector<AlignedVector<Scalar>> activations;
+            std::vector<AlignedVector<Scalar>> deltas;
+            AlignedVector<Scalar> grads; // arena-shaped, unused by shard 0 which writes the arena directly
+        };
+
+        // forward and backward pass over batch rows [first, first + rows), gradients accumulate into `grads`
+        void backpropagate(const Scalar* states, const int* actions, const double* targets, const double* weights,
+                           double* td_errors, int first, int rows, LearnShard& shard, Scalar* grads) const;
+        // sums shards 1..n-1 into the arena gradients with a fixed pairwise tree, clearing them
+        void reduceShardGradients(int numShards);
+        // one fused Adam pass over the arena, leaves every gradient at zero
+        void applyGradients();
+
+        // parameters, gradients and Adam moments of every layer, layers hold views into it
+        ParameterArena<Scalar, MomentScalar> arena;
+        std::vector<LayerT<Scalar, MomentScalar>> layers;
         double learnRate;
         double epsilon;
         std::string path;
+
+        // scratch reused by learn(): encoded states, one row per sample, and per-shard buffers
+        AlignedVector<Scalar> batch_input;
+        std::vector<int> batch_actions;
+        std::vector<double> batch_targets;
+        std::vector<LearnShard> shards;
 };
+
+using NeuralNetwork = NeuralNetworkT<net_scalar, moment_scalar>;
     
\ No newline at end of file
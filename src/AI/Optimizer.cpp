@@ -1,7 +1,48 @@
 #include "Optimizer.h"
+#include "ThreadPool.h"
+#include "../Log.h"
+#include <algorithm>
+#include <type_traits>
+
+// below this many elements per thread the pool hand-off costs more than the update
+static const std::size_t ADAM_MIN_CHUNK = 1 << 15;
+
+template <typename Scalar, typename MomentScalar>
+static void adamUpdateSerial(Scalar* params, MomentScalar* m, MomentScalar* v, Scalar* grads, std::size_t n,
+                             const AdamStepParams& step) {
+    const KernelTable<Scalar>& k = kernels<Scalar>();
+    if constexpr (std::is_same<Scalar, MomentScalar>::value) {
+        k.adamUpdate(params, m, v, grads, static_cast<int>(n), step);
+    } else {
+        k.adamUpdateWide(params, m, v, grads, static_cast<int>(n), step);
+    }
+}
+
+template <typename Scalar, typename MomentScalar>
+void adamUpdateRange(Scalar* params, MomentScalar* m, MomentScalar* v, Scalar* grads, std::size_t n,
+                     const AdamStepParams& step) {
+    ThreadPool& pool = ThreadPool::shared();
+    const int chunks = static_cast<int>(std::min<std::size_t>(pool.size(), n / ADAM_MIN_CHUNK));
+    if (chunks <= 1) {
+        adamUpdateSerial(params, m, v, grads, n, step);
+        return;
+    }
+
+    // chunk boundaries stay on cache lines so no two threads share one
+    const std::size_t line = 64 / sizeof(Scalar);
+    const std::size_t chunk = (n / chunks + line - 1) / line * line;
+    pool.run(chunks, [&](int c) {
+        std::size_t begin = c * chunk;
+        std::size_t end = std::min(n, begin + chunk);
+        if (begin < end) {
+            adamUpdateSerial(params + begin, m + begin, v + begin, grads + begin, end - begin, step);
+        }
+    });
+}
 
 // Default constructor 
-AdamOptimizer::AdamOptimizer()
+template <typename Scalar, typename MomentScalar>
+AdamOptimizerT<Scalar, MomentScalar>::AdamOptimizerT()
     : alpha(0.001), beta_one(0.9), beta_two(0.999), epsilon_stable(1e-8),
       training_steps(0), beta_one_power(1.0), beta_two_power(1.0),
       input_features(0), output_features(0), layer_identifier(-1)
@@ -10,63 +51,55 @@ AdamOptimizer::AdamOptimizer()
 }
 
 // Parameterized constructor
-AdamOptimizer::AdamOptimizer(int num_input, int num_output, double b1, double b2, double eps, double learning_r, int layer_id)
+template <typename Scalar, typename MomentScalar>
+AdamOptimizerT<Scalar, MomentScalar>::AdamOptimizerT(int num_input, int num_output, double b1, double b2, double eps, double learning_r, int layer_id)
     : alpha(learning_r), beta_one(b1), beta_two(b2), epsilon_stable(eps),
       training_steps(0), beta_one_power(1.0), beta_two_power(1.0),
       input_features(num_input), output_features(num_output), layer_identifier(layer_id)
 {
-    weight_first_moment.assign(input_features, std::vector<double>(output_features, 0.0));
-    weight_second_moment.assign(input_features, std::vector<double>(output_features, 0.0));
-    bias_first_moment.assign(output_features, 0.0);
-    bias_second_moment.assign(output_features, 0.0);
+}
+
+template <typename Scalar, typename MomentScalar>
+void AdamOptimizerT<Scalar, MomentScalar>::bind(ParamSpan<MomentScalar> w_first, ParamSpan<MomentScalar> w_second,
+                                                ParamSpan<MomentScalar> b_first, ParamSpan<MomentScalar> b_second) {
+    weight_first_moment = w_first;
+    weight_second_moment = w_second;
+    bias_first_moment = b_first;
+    bias_second_moment = b_second;
 }
 
 
-void AdamOptimizer::optimize(std::vector<std::vector<double>>& layer_weights, std::vector<double>& layer_biases,
-                                    const std::vector<std::vector<double>>& weight_gradients, const std::vector<double>& bias_gradients)
-{
+template <typename Scalar, typename MomentScalar>
+AdamStepParams AdamOptimizerT<Scalar, MomentScalar>::advance() {
     training_steps++; 
 
     // Update bias correction terms
     beta_one_power *= beta_one;
     beta_two_power *= beta_two;
 
-    // Update moment estimates and apply updates for weights
-    for (int i = 0; i < input_features; ++i) {
-        for (int j = 0; j < output_features; ++j) {
-            // Update biased first and second moment estimates
-            weight_first_moment[i][j] = weight_first_moment[i][j] * beta_one + (1 - beta_one) * weight_gradients[i][j];
-            weight_second_moment[i][j] = weight_second_moment[i][j] * beta_two + (1 - beta_two) * weight_gradients[i][j] * weight_gradients[i][j];
-
-            // Compute bias-corrected first and second moment estimates
-            double corrected_m = weight_first_moment[i][j] / (1 - beta_one_power);
-            double corrected_v = weight_second_moment[i][j] / (1 - beta_two_power);
-
-            // Update weights
-            layer_weights[i][j] -= alpha * corrected_m / (std::sqrt(corrected_v) + epsilon_stable);
-        }
-    }
-
-    // Update moment estimates and apply updates for biases
-    for (int i = 0; i < output_features; ++i) {
-        // Update biased first and second moment estimates
-        bias_first_moment[i] = bias_first_moment[i] * beta_one + (1 - beta_one) * bias_gradients[i];
-        bias_second_moment[i] = bias_second_moment[i] * beta_two + (1 - beta_two) * bias_gradients[i] * bias_gradients[i];
+    // bias corrections are the same for every element of this step
+    return {beta_one, beta_two, alpha, 1.0 / (1 - beta_one_power), 1.0 / (1 - beta_two_power), epsilon_stable};
+}
 
-        // Compute bias-corrected first and second moment estimates
-        double corrected_m = bias_first_moment[i] / (1 - beta_one_power);
-        double corrected_v = bias_second_moment[i] / (1 - beta_two_power);
+template <typename Scalar, typename MomentScalar>
+void AdamOptimizerT<Scalar, MomentScalar>::optimize(ParamSpan<Scalar> layer_weights, ParamSpan<Scalar> layer_biases,
+                                                    ParamSpan<Scalar> weight_gradients, ParamSpan<Scalar> bias_gradients)
+{
+    AdamStepParams step = advance();
 
-        // Update biases
-        layer_biases[i] -= alpha * corrected_m / (std::sqrt(corrected_v) + epsilon_stable);
-    }
+    // Update moment estimates and apply updates for weights, then biases
+    adamUpdateRange(layer_weights.data(), weight_first_moment.data(), weight_second_moment.data(),
+                    weight_gradients.data(), layer_weights.size(), step);
+    adamUpdateRange(layer_biases.data(), bias_first_moment.data(), bias_second_moment.data(),
+                    bias_gradients.data(), layer_biases.size(), step);
 }
 
-void AdamOptimizer::save(const std::string& file_path) const {
+template <typename Scalar, typename MomentScalar>
+void AdamOptimizerT<Scalar, MomentScalar>::save(const std::string& file_path) const {
     std::ofstream outFile(file_path + "/layer" + std::to_string(layer_identifier) + "_adam_state.txt");
 
     if (!outFile) {
-        std::cerr << "Could not open file " << file_path << "/layer" << layer_identifier << "_adam_state.txt for writing." << std::endl;
+        LOG_ERROR("Could not open file " << file_path << "/layer" << layer_identifier << "_adam_state.txt for writing.");
         return;
     }
 
@@ -77,7 +110,7 @@ void AdamOptimizer::save(const std::string& file_path) const {
     // moment estimates for weights
     for (int i = 0; i < input_features; ++i) {
         for (int j = 0; j < output_features; ++j) {
-            outFile << weight_first_moment[i][j] << (j == output_features - 1 ? "" : " ");
+            outFile << weight_first_moment[i * output_features + j] << (j == output_features - 1 ? "" : " ");
         }
         outFile << std::endl;
     }
@@ -85,7 +118,7 @@ void AdamOptimizer::save(const std::string& file_path) const {
     // moment estimates for weight_second_moment
     for (int i = 0; i < input_features; ++i) {
         for (int j = 0; j < output_features; ++j) {
-            outFile << weight_second_moment[i][j] << (j == output_features - 1 ? "" : " ");
+            outFile << weight_second_moment[i * output_features + j] << (j == output_features - 1 ? "" : " ");
         }
         outFile << std::endl;
     }
@@ -105,12 +138,13 @@ void AdamOptimizer::save(const std::string& file_path) const {
     outFile.close();
 }
 
-void AdamOptimizer::load(const std::string& file_path) {
+template <typename Scalar, typename MomentScalar>
+bool AdamOptimizerT<Scalar, MomentScalar>::load(const std::string& file_path) {
     std::ifstream inFile(file_path + "/layer" + std::to_string(layer_identifier) + "_adam_state.txt");
 
     if (!inFile) {
-        std::cerr << "Could not open file " << file_path << "/layer" << layer_identifier << "_adam_state.txt for reading. Initializing new Adam configuration..." << std::endl;
-        return;
+        LOG_WARN("Could not open file " << file_path << "/layer" << layer_identifier << "_adam_state.txt for reading. Initializing new Adam configuration...");
+        return false;
     }
 
     std::string line;
@@ -119,22 +153,20 @@ void AdamOptimizer::load(const std::string& file_path) {
     if (std::getline(inFile, line)) {
         iss.str(line);
         if (!(iss >> alpha >> beta_one >> beta_two >> epsilon_stable >> training_steps >> beta_one_power >> beta_two_power)) {
-            std::cerr << "Error: Failed to read Adam hyperparameters and state from file" << std::endl;
+            LOG_ERROR("Error: Failed to read Adam hyperparameters and state from file");
             inFile.close();
-            return;
+            return false;
         }
     } else {
-        std::cerr << "Error: File is empty or malformed" << std::endl;
+        LOG_ERROR("Error: File is empty or malformed");
         inFile.close();
-        return;
+        return false;
     }
 
-    if (weight_first_moment.empty() || weight_first_moment.size() != static_cast<size_t>(input_features) ||
-    (input_features > 0 && weight_first_moment[0].size() != static_cast<size_t>(output_features))){ 
-         weight_first_moment.resize(input_features, std::vector<double>(output_features));
-         weight_second_moment.resize(input_features, std::vector<double>(output_features));
-         bias_first_moment.resize(output_features);
-         bias_second_moment.resize(output_features);
+    if (weight_first_moment.size() != static_cast<size_t>(input_features * output_features)) {
+        LOG_ERROR("Error: Adam moments of layer " << layer_identifier << " are not bound to the parameter arena");
+        inFile.close();
+        return false;
     }
 
 
@@ -143,16 +175,16 @@ void AdamOptimizer::load(const std::string& file_path) {
             iss.clear(); 
             iss.str(line);
             for (int j = 0; j < output_features; ++j) {
-                if (!(iss >> weight_first_moment[i][j])) {
-                    std::cerr << "Error: Failed to read weight_first_moment value at position [" << i << "][" << j << "]." << std::endl;
+                if (!(iss >> weight_first_moment[i * output_features + j])) {
+                    LOG_ERROR("Error: Failed to read weight_first_moment value at position [" << i << "][" << j << "].");
                     inFile.close();
-                    return;
+                    return false;
                 }
             }
         } else {
-            std::cerr << "Error: Not enough lines to read weight_first_moment values." << std::endl;
+            LOG_ERROR("Error: Not enough lines to read weight_first_moment values.");
             inFile.close();
-            return;
+            return false;
         }
     }
 
@@ -161,16 +193,16 @@ void AdamOptimizer::load(const std::string& file_path) {
             iss.clear(); 
             iss.str(line);
             for (int j = 0; j < output_features; ++j) {
-                if (!(iss >> weight_second_moment[i][j])) {
-                    std::cerr << "Error: Failed to read weight_second_moment value at position [" << i << "][" << j << "]." << std::endl;
+                if (!(iss >> weight_second_moment[i * output_features + j])) {
+                    LOG_ERROR("Error: Failed to read weight_second_moment value at position [" << i << "][" << j << "].");
                     inFile.close();
-                    return;
+                    return false;
                 }
             }
         } else {
-            std::cerr << "Error: Not enough lines to read weight_second_moment values." << std::endl;
+            LOG_ERROR("Error: Not enough lines to read weight_second_moment values.");
             inFile.close();
-            return;
+            return false;
         }
     }
 
@@ -179,15 +211,15 @@ void AdamOptimizer::load(const std::string& file_path) {
         iss.str(line);
         for (int i = 0; i < output_features; ++i) {
             if (!(iss >> bias_first_moment[i])) {
-                std::cerr << "Error: Failed to read bias_first_moment value at position [" << i << "]." << std::endl;
+                LOG_ERROR("Error: Failed to read bias_first_moment value at position [" << i << "].");
                 inFile.close();
-                return;
+                return false;
             }
         }
     } else {
-        std::cerr << "Error: Failed to read bias_first_moment values for the biases." << std::endl;
+        LOG_ERROR("Error: Failed to read bias_first_moment values for the biases.");
         inFile.close();
-        return;
+        return false;
     }
 
     if (std::getline(inFile, line)) {
@@ -195,16 +227,25 @@ void AdamOptimizer::load(const std::string& file_path) {
         iss.str(line);
         for (int i = 0; i < output_features; ++i) {
             if (!(iss >> bias_second_moment[i])) {
-                std::cerr << "Error: Failed to read bias_second_moment value at position [" << i << "]." << std::endl;
+                LOG_ERROR("Error: Failed to read bias_second_moment value at position [" << i << "].");
                 inFile.close();
-                return;
+                return false;
             }
         }
     } else {
-        std::cerr << "Error: Failed to read bias_second_moment values for the biases." << std::endl;
+        LOG_ERROR("Error: Failed to read bias_second_moment values for the biases.");
         inFile.close();
-        return;
+        return false;
     }
 
     inFile.close();
-}
\ No newline at end of file
+    return true;
+}
+
+template void adamUpdateRange<double, double>(double*, double*, double*, double*, std::size_t, const AdamStepParams&);
+template void adamUpdateRange<float, float>(float*, float*, float*, float*, std::size_t, const AdamStepParams&);
+template void adamUpdateRange<float, double>(float*, double*, double*, float*, std::size_t, const AdamStepParams&);
+
+template class AdamOptimizerT<double, double>;
+template class AdamOptimizerT<float, float>;
+template class AdamOptimizerT<float, double>;
@@ -6,9 +6,15 @@
 #include <fstream> 
 #include <sstream> 
 #include <numeric> 
+#include "AlignedAllocator.h"
+#include "Kernels.h"
+#include "ParameterArena.h"
+#include "Precision.h"
 
 
-class AdamOptimizer {
+// Adam over parameters of type Scalar, moments kept in MomentScalar
+template <typename Scalar, typename MomentScalar = Scalar>
+class AdamOptimizerT {
 public:
 
     double alpha; // Learning rate 
@@ -20,28 +26,44 @@ public:
     double beta_one_power; // beta_one raised to the power of training_steps
     double beta_two_power; // beta_two raised to the power of training_steps
 
-    std::vector<std::vector<double>> weight_first_moment;  // First moment for weights
-    std::vector<std::vector<double>> weight_second_moment; // Second moment for weights
-    std::vector<double> bias_first_moment;   // First moment for biases
-    std::vector<double> bias_second_moment;  // Second moment for biases
+    // views into the network's ParameterArena, bound by the owning layer
+    ParamSpan<MomentScalar> weight_first_moment;  // First moment for weights, row-major like the layer weights
+    ParamSpan<MomentScalar> weight_second_moment; // Second moment for weights
+    ParamSpan<MomentScalar> bias_first_moment;   // First moment for biases
+    ParamSpan<MomentScalar> bias_second_moment;  // Second moment for biases
 
     int input_features;
     int output_features;
     int layer_identifier;
 
     // Default constructor
-    AdamOptimizer();
+    AdamOptimizerT();
 
     // Parameterized constructor
-    AdamOptimizer(int num_input, int num_output, double b1, double b2, double eps, double learning_r, int layer_id);
+    AdamOptimizerT(int num_input, int num_output, double b1, double b2, double eps, double learning_r, int layer_id);
 
-    AdamOptimizer(const AdamOptimizer& other) = default;
-    AdamOptimizer& operator=(const AdamOptimizer& other) = default;
+    AdamOptimizerT(const AdamOptimizerT& other) = default;
+    AdamOptimizerT& operator=(const AdamOptimizerT& other) = default;
     
-    void optimize(std::vector<std::vector<double>>& layer_weights, std::vector<double>& layer_biases,
-                         const std::vector<std::vector<double>>& weight_gradients, const std::vector<double>& bias_gradients);
+    void bind(ParamSpan<MomentScalar> w_first, ParamSpan<MomentScalar> w_second,
+              ParamSpan<MomentScalar> b_first, ParamSpan<MomentScalar> b_second);
+
+    // advances the step counters and returns this step's constants
+    AdamStepParams advance();
+
+    // single layer step, gradients are zeroed as they are consumed
+    void optimize(ParamSpan<Scalar> layer_weights, ParamSpan<Scalar> layer_biases,
+                  ParamSpan<Scalar> weight_gradients, ParamSpan<Scalar> bias_gradients);
 
     void save(const std::string& file_path) const;
 
-    void load(const std::string& file_path);
+    bool load(const std::string& file_path);
 };
+
+// Fused Adam over n contiguous elements (moments, bias-corrected step, gradient reset),
+// split across ThreadPool::shared() when n is large enough to pay for the hand-off
+template <typename Scalar, typename MomentScalar>
+void adamUpdateRange(Scalar* params, MomentScalar* first_moment, MomentScalar* second_moment,
+                     Scalar* grads, std::size_t n, const AdamStepParams& step);
+
+using AdamOptimizer = AdamOptimizerT<net_scalar, moment_scalar>;
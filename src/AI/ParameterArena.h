@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include "AlignedAllocator.h"
+
+// Non-owning view of one section of a ParameterArena
+template <typename T>
+class ParamSpan {
+public:
+    ParamSpan() = default;
+    ParamSpan(T* data, std::size_t size) : ptr(data), count(size) {}
+
+    T* data() const { return ptr; }
+    std::size_t size() const { return count; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + count; }
+    T& operator[](std::size_t i) const { return ptr[i]; }
+
+private:
+    T* ptr = nullptr;
+    std::size_t count = 0;
+};
+
+// All trainable state of a network in four parallel flat buffers, so the
+// optimizer can sweep parameters, gradients and moments in a single pass.
+// A layer's weights and biases sit at the same offsets in every buffer.
+template <typename Scalar, typename MomentScalar = Scalar>
+struct ParameterArena {
+    AlignedVector<Scalar> params;
+    AlignedVector<Scalar> grads;
+    AlignedVector<MomentScalar> first_moment;
+    AlignedVector<MomentScalar> second_moment;
+
+    // sections are rounded up so each one starts on a cache line; the padding
+    // has zero gradients and stays zero under Adam
+    static std::size_t padded(std::size_t n) {
+        const std::size_t line = 64 / sizeof(Scalar);
+        return (n + line - 1) / line * line;
+    }
+
+    void allocate(std::size_t n) {
+        params.assign(n, 0);
+        grads.assign(n, 0);
+        first_moment.assign(n, 0);
+        second_moment.assign(n, 0);
+    }
+
+    std::size_t size() const { return params.size(); }
+};
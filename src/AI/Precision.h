@@ -0,0 +1,15 @@
+#pragma once
+
+// Scalar types of the Q-network, picked at build time with `make PRECISION=double|float|mixed`.
+// mixed keeps parameters and activations in float but Adam moments in double.
+#ifdef RL_FLOAT_NETWORK
+using net_scalar = float;
+#else
+using net_scalar = double;
+#endif
+
+#ifdef RL_DOUBLE_MOMENTS
+using moment_scalar = double;
+#else
+using moment_scalar = net_scalar;
+#endif
@@ -0,0 +1,128 @@
+#include "ReplayBuffer.h"
+#include "../Log.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ReplayBuffer::ReplayBuffer(size_t capacity)
+    : capacity_(capacity), rng(std::random_device{}()),
+      memory((storageBytes(capacity) + sizeof(uint64_t) - 1) / sizeof(uint64_t)) {
+    attach(reinterpret_cast<unsigned char*>(memory.data()));
+    std::memcpy(header->magic, REPLAY_FILE_MAGIC, sizeof(header->magic));
+    header->version = REPLAY_FILE_VERSION;
+    header->capacity = capacity;
+    header->stride = stride;
+    header->max_priority = max_priority;
+}
+
+ReplayBuffer::~ReplayBuffer() {
+    if (mapped) munmap(mapped, mapped_bytes);
+}
+
+void ReplayBuffer::attach(unsigned char* base) {
+    header = reinterpret_cast<ReplayFileHeader*>(base);
+    states = reinterpret_cast<uint32_t*>(base + sizeof(ReplayFileHeader));
+    next_states = states + capacity_;
+    rewards = reinterpret_cast<float*>(next_states + capacity_);
+    codes = reinterpret_cast<uint8_t*>(rewards + capacity_);
+}
+
+bool ReplayBuffer::mapFile(const std::string& file_path) {
+    const size_t bytes = storageBytes(capacity_);
+    const int fd = open(file_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Could not open replay file " << file_path << ": " << std::strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    const bool fresh = fstat(fd, &st) == 0 && st.st_size == 0;
+    if (fresh && ftruncate(fd, bytes) != 0) {
+        LOG_ERROR("Could not size replay file " << file_path << ": " << std::strerror(errno));
+        close(fd);
+        return false;
+    }
+    if (!fresh && st.st_size != static_cast<off_t>(bytes)) {
+        LOG_ERROR(file_path << " does not hold a replay buffer of capacity " << capacity_);
+        close(fd);
+        return false;
+    }
+
+    void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        LOG_ERROR("Could not map replay file " << file_path << ": " << std::strerror(errno));
+        return false;
+    }
+    // sampling reads scattered slots, read-ahead would only fetch pages nobody asked for
+    madvise(region, bytes, MADV_RANDOM);
+
+    const auto* stored = static_cast<const ReplayFileHeader*>(region);
+    if (!fresh && (std::memcmp(stored->magic, REPLAY_FILE_MAGIC, sizeof(stored->magic)) != 0
+                   || stored->version != REPLAY_FILE_VERSION || stored->capacity != capacity_
+                   || stored->head >= capacity_ || stored->count > capacity_ || stored->stride == 0)) {
+        LOG_ERROR(file_path << " is not a replay file (version " << REPLAY_FILE_VERSION << ")");
+        munmap(region, bytes);
+        return false;
+    }
+
+    // a new file takes over what is in memory, untouched columns stay sparse
+    if (fresh) {
+        std::memcpy(region, header, sizeof(ReplayFileHeader));
+        if (count > 0) {
+            std::memcpy(static_cast<unsigned char*>(region) + sizeof(ReplayFileHeader), states,
+                        bytes - sizeof(ReplayFileHeader));
+        }
+    }
+    memory.clear();
+    memory.shrink_to_fit();
+    if (mapped) munmap(mapped, mapped_bytes);
+    mapped = region;
+    mapped_bytes = bytes;
+    attach(static_cast<unsigned char*>(region));
+
+    head = header->head;
+    count = header->count;
+    added_ = header->added;
+    stride = header->stride;
+    max_priority = std::max(header->max_priority, PRIORITY_EPSILON);
+    // the steps that would have continued the newest transitions were never written
+    cutNewest(stride);
+    if (alpha > 0.0) {
+        priorities.reset(capacity_);
+        resetPriorities();
+    }
+    if (!fresh) LOG_INFO("Continuing with " << count << " transitions from " << file_path);
+    return true;
+}
+
+bool ReplayBuffer::rollBack(uint64_t position) {
+    if (position > added_) {
+        LOG_WARN("The replay buffer holds " << added_ << " transitions, not the " << position << " to roll back to");
+        return false;
+    }
+    const uint64_t dropped = added_ - position;
+    const size_t kept = static_cast<size_t>(std::min<uint64_t>(position, capacity_));
+    if (dropped + kept > count) {
+        LOG_WARN("The replay buffer has overwritten transitions since position " << position
+                 << ", it cannot be rolled back");
+        return false;
+    }
+
+    head = (head + capacity_ - dropped % capacity_) % capacity_;
+    count = kept;
+    added_ = position;
+    header->head = head;
+    header->count = count;
+    header->added = added_;
+    // the dropped steps continued some of the transitions now newest
+    cutNewest(stride);
+    if (alpha > 0.0) {
+        priorities.reset(capacity_);
+        resetPriorities();
+    }
+    return true;
+}
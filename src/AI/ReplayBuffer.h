@@ -1,47 +1,351 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
-#include <deque>
+#include <mutex>
 #include <random>
+#include <string>
+#include "AlignedAllocator.h"
+#include "../Profiler.h"
+#include "Precision.h"
 #include "State.h"
+#include "SumTree.h"
 
-struct Transition {
-    State state;
-    int action;
-    double reward;
-    State nextState;
-    bool done;
+// Minibatch gathered from a ReplayBuffer. The rows are ready to feed to the
+// networks; the buffers are reused, so sampling into the same batch again
+// does not allocate.
+struct ReplayBatch {
+    int size = 0;
+    int features = 0;
+    AlignedVector<net_scalar> states;      // [size x features]
+    AlignedVector<net_scalar> next_states; // [size x features]
+    std::vector<int> actions;
+    std::vector<double> rewards;
+    std::vector<uint8_t> dones;
+    std::vector<size_t> indices;           // buffer slots the rows were copied from
+    std::vector<double> weights;           // importance-sampling weights, empty for uniform sampling
+    std::vector<double> discounts;         // gamma^k of the bootstrap after k steps, empty for one-step returns
+
+    void resize(int n, int nFeatures) {
+        size = n;
+        features = nFeatures;
+        states.resize(static_cast<size_t>(n) * nFeatures);
+        next_states.resize(static_cast<size_t>(n) * nFeatures);
+        actions.resize(n);
+        rewards.resize(n);
+        dones.resize(n);
+        indices.resize(n);
+        weights.clear();
+        discounts.clear();
+    }
+};
+
+// Header of a replay file (.rlrb), followed by the states, next states,
+// rewards and codes columns of `capacity` slots each. The ring position lives
+// in the header, so the file describes its transitions even after a crash.
+static const char REPLAY_FILE_MAGIC[8] = {'R', 'L', 'R', 'E', 'P', 'L', 'A', 'Y'};
+static const uint32_t REPLAY_FILE_VERSION = 2;
+
+struct ReplayFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t count;
+    uint64_t stride;
+    double max_priority;
+    uint64_t added;  // transitions added since the buffer was cleared
 };
+static_assert(sizeof(ReplayFileHeader) == 64, "replay file header must stay 64 bytes");
 
+// Fixed-capacity ring of transitions stored as columns of 13 bytes per
+// transition: state and next state packed into 32 bits each (see packState),
+// the reward as a float and the action with its flags in one byte. The
+// network features are rebuilt from a FeatureTable of the track when a batch
+// is gathered. All storage is allocated up front, in memory or in a file
+// mapped with mapFile(), in which case only the pages sampling touches need
+// to be resident and the transitions survive the process.
+//
+// With a priority exponent alpha > 0 sampling is prioritized (Schaul et al.):
+// slot i is drawn with probability p_i^alpha / sum p^alpha, where p_i is its
+// last |TD error|, new transitions get the largest priority seen so far, and
+// sampled batches carry importance weights normalized to at most 1.
+//
+// With n > 1 a sampled transition carries the discounted return of up to n
+// steps of its episode, summed at sample time from the transitions that
+// follow it, and the state and done flag n steps later. The next step of a
+// transition is `stride` slots further (the number of cars stepped together).
+// A return stops early at the end of an episode, at the newest transition, or
+// where the stream was cut (see append()); `discounts` then holds gamma^k for
+// the k steps actually taken.
 class ReplayBuffer {
     public:
-        ReplayBuffer(size_t capacity)
-            : capacity(capacity), rng(rd()) {}
-    
-        void add(const Transition& t) {
-            if (buffer.size() >= capacity) {
-                buffer.pop_front();
+        ReplayBuffer(size_t capacity);
+        ~ReplayBuffer();
+        ReplayBuffer(const ReplayBuffer&) = delete;
+        ReplayBuffer& operator=(const ReplayBuffer&) = delete;
+
+        // moves the storage into `file_path`, continuing with the transitions already
+        // in it when the file exists. Priorities are not stored, reopened transitions
+        // all get the largest one seen. Prints the reason and returns false on failure,
+        // the buffer then stays in memory.
+        bool mapFile(const std::string& file_path);
+
+        // one transition between packed states, overwrites the oldest one when full. episode_end
+        // marks the last step of an episode that ran out of time without a terminal state.
+        void add(uint32_t state, int action, double reward, uint32_t next_state, bool done, bool episode_end = false) {
+            const size_t slot = head;
+            states[slot] = state;
+            next_states[slot] = next_state;
+            rewards[slot] = static_cast<float>(reward);
+            codes[slot] = static_cast<uint8_t>(action & ACTION_MASK) | (done ? DONE : 0)
+                        | (done || episode_end ? 0 : CONTINUES);
+            if (alpha > 0.0) priorities.set(slot, std::pow(max_priority, alpha));
+            head = head + 1 == capacity_ ? 0 : head + 1;
+            count = std::min(count + 1, capacity_);
+            header->head = head;
+            header->count = count;
+            header->added = ++added_;
+        }
+
+        // every transition of `other`, oldest first. Its last `stride` transitions are
+        // cut from whatever is appended next, so n-step returns never run into another chunk.
+        void append(const ReplayBuffer& other) {
+            for (size_t i = 0; i < other.size(); ++i) {
+                const size_t slot = other.slot(i);
+                const uint8_t code = other.codes[slot];
+                add(other.states[slot], code & ACTION_MASK, other.rewards[slot], other.next_states[slot],
+                    (code & DONE) != 0, !(code & CONTINUES) || i + stride >= other.size());
+            }
+        }
+
+        void clear() {
+            head = 0;
+            count = 0;
+            header->head = 0;
+            header->count = 0;
+            header->added = added_ = 0;
+            if (alpha > 0.0) priorities.reset(capacity_);
+        }
+
+        // 0 keeps uniform sampling. Until the first priority update every
+        // transition has the same priority, so sampling starts out uniform.
+        void setPriorityExponent(double exponent) {
+            alpha = exponent;
+            priorities.reset(alpha > 0.0 ? capacity_ : 0);
+            max_priority = PRIORITY_EPSILON;
+            header->max_priority = max_priority;
+            resetPriorities();
+        }
+        bool prioritized() const { return alpha > 0.0; }
+
+        // n-step returns with discount gamma, n = 1 keeps one-step transitions
+        void setNStep(size_t n, double discount) {
+            n_step = std::max<size_t>(1, n);
+            gamma = discount;
+        }
+        // slots between consecutive steps of one car. Stored transitions were written
+        // with the old stride, so a change cuts their returns.
+        void setStride(size_t s) {
+            s = std::max<size_t>(1, s);
+            if (s != stride) cutNewest(count);
+            stride = s;
+            header->stride = s;
+        }
+        size_t nStep() const { return n_step; }
+        double discount() const { return gamma; }
+        double priorityExponent() const { return alpha; }
+
+        // n slots drawn with replacement: uniformly, or one per equal slice of the
+        // priority mass when prioritized
+        void sampleIndices(size_t n, size_t* out) {
+            if (alpha > 0.0) {
+                const double segment = priorities.total() / n;
+                for (size_t i = 0; i < n; ++i) {
+                    std::uniform_real_distribution<double> dist(segment * i, segment * (i + 1));
+                    out[i] = std::min(priorities.find(dist(rng)), count - 1);
+                }
+                return;
+            }
+            std::uniform_int_distribution<size_t> dist(0, count - 1);
+            for (size_t i = 0; i < n; ++i) out[i] = dist(rng);
+        }
+
+        // importance weights (N P(i))^-beta / max_j (N P(j))^-beta of slots idx[0..n)
+        void importanceWeights(const size_t* idx, size_t n, double beta, double* out) const {
+            const double total = priorities.total();
+            const double max_weight = std::pow(count * priorities.min() / total, -beta);
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = std::pow(count * priorities.get(idx[i]) / total, -beta) / max_weight;
             }
-            buffer.push_back(t);
-        }
-    
-        std::vector<Transition> sample(size_t batchSize) {
-            std::vector<Transition> batch;
-            std::uniform_int_distribution<size_t> dist(0, buffer.size() - 1);
-    
-            for (size_t i = 0; i < batchSize; ++i) {
-                size_t index = dist(rng);
-                batch.push_back(buffer[index]);
+        }
+
+        // new priorities |td_errors[i]| for slots idx[0..n)
+        void updatePriorities(const size_t* idx, const double* td_errors, size_t n) {
+            if (alpha <= 0.0) return;
+            for (size_t i = 0; i < n; ++i) {
+                const double p = std::abs(td_errors[i]) + PRIORITY_EPSILON;
+                max_priority = std::max(max_priority, p);
+                priorities.set(idx[i], std::pow(p, alpha));
             }
-            return batch;
+            header->max_priority = max_priority;
         }
-    
-        size_t size() const {
-            return buffer.size();
+
+        // the transitions in slots idx[0..n) as feature rows of `table`, which must cover every stored position
+        void gather(const size_t* idx, size_t n, const FeatureTable& table, ReplayBatch& batch) const {
+            const int features = State::NUM_FEATURES;
+            batch.resize(static_cast<int>(n), features);
+            if (n_step > 1) batch.discounts.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                const size_t slot = idx[i];
+                // with n-step returns the next state is the one the return bootstraps from
+                const size_t last = n_step > 1 ? accumulateReturn(slot, i, batch) : slot;
+                if (n_step == 1) batch.rewards[i] = rewards[slot];
+                table.encodePacked(states[slot], &batch.states[i * features]);
+                table.encodePacked(next_states[last], &batch.next_states[i * features]);
+                batch.actions[i] = codes[slot] & ACTION_MASK;
+                batch.dones[i] = (codes[last] & DONE) != 0;
+                batch.indices[i] = slot;
+            }
+        }
+
+        // minibatch of n transitions, with importance weights for exponent beta when prioritized
+        void sample(size_t n, const FeatureTable& table, ReplayBatch& batch, double beta = 1.0) {
+            PROFILE_SCOPE("replay_sample");
+            batch.indices.resize(n);
+            sampleIndices(n, batch.indices.data());
+            gather(batch.indices.data(), n, table, batch);
+            if (alpha > 0.0) {
+                batch.weights.resize(n);
+                importanceWeights(batch.indices.data(), n, beta, batch.weights.data());
+            }
         }
-    
+
+        size_t size() const { return count; }
+        size_t capacity() const { return capacity_; }
+        // transitions added since the buffer was cleared, a position for rollBack()
+        uint64_t added() const { return added_; }
+        // drops every transition added after added() returned `position`. Prints the
+        // reason and returns false when the buffer no longer holds that state: it never
+        // got that far, or the ring has since overwritten transitions it held then.
+        bool rollBack(uint64_t position);
+        bool fileBacked() const { return mapped != nullptr; }
+        // sampling generator, saved with the training state
+        std::mt19937& generator() { return rng; }
+
     private:
-        std::deque<Transition> buffer;
-        size_t capacity;
-        std::random_device rd;
+        // action in the low bits of a code byte, then the flags
+        static constexpr uint8_t ACTION_MASK = 0x3f;
+        static constexpr uint8_t DONE = 0x40;      // terminal transition
+        static constexpr uint8_t CONTINUES = 0x80; // the episode goes on at slot + stride
+
+        // slot of the i-th oldest transition
+        size_t slot(size_t i) const { return (head + capacity_ - count + i) % capacity_; }
+
+        // ends the returns of the newest n transitions at themselves
+        void cutNewest(size_t n) {
+            for (size_t i = count - std::min(n, count); i < count; ++i) codes[slot(i)] &= ~CONTINUES;
+        }
+
+        // every stored transition at the largest priority seen
+        void resetPriorities() {
+            if (alpha <= 0.0) return;
+            for (size_t i = 0; i < count; ++i) priorities.set(slot(i), std::pow(max_priority, alpha));
+        }
+
+        // header and columns inside `base`, which holds storageBytes(capacity_)
+        void attach(unsigned char* base);
+        static size_t storageBytes(size_t capacity) { return sizeof(ReplayFileHeader) + 13 * capacity; }
+
+        // transitions added after `slot`
+        size_t newer(size_t slot) const { return (head + capacity_ - slot - 1) % capacity_; }
+
+        // n-step return and discount of the transition in `slot` into row i of `batch`,
+        // returns the slot of the step it ends on
+        size_t accumulateReturn(size_t slot, size_t i, ReplayBatch& batch) const {
+            double ret = rewards[slot];
+            double discount = gamma;
+            size_t last = slot;
+            for (size_t k = 1; k < n_step; ++k) {
+                if (!(codes[last] & CONTINUES) || newer(last) < stride) break;
+                last = (last + stride) % capacity_;
+                ret += discount * rewards[last];
+                discount *= gamma;
+            }
+            batch.rewards[i] = ret;
+            batch.discounts[i] = discount;
+            return last;
+        }
+
+        // keeps zero-error transitions sampleable
+        static constexpr double PRIORITY_EPSILON = 1e-6;
+
+        size_t capacity_;
+        size_t head = 0;  // next slot written
+        size_t count = 0;
+        uint64_t added_ = 0;
+        size_t n_step = 1;
+        double gamma = 1.0;
+        size_t stride = 1;
         std::mt19937 rng;
+
+        // storage is either `memory` or a mapping of `mapped_bytes` bytes
+        std::vector<uint64_t> memory;
+        void* mapped = nullptr;
+        size_t mapped_bytes = 0;
+
+        ReplayFileHeader* header = nullptr;
+        uint32_t* states = nullptr;
+        uint32_t* next_states = nullptr;
+        float* rewards = nullptr;
+        uint8_t* codes = nullptr;
+
+        double alpha = 0.0;
+        double max_priority = PRIORITY_EPSILON; // largest |TD error| seen, given to new transitions
+        SumTree priorities;
+};
+
+// ReplayBuffer shared by actor threads and a learner. Actors fill a small
+// private buffer and add it as one chunk, so the lock is taken once per chunk.
+class SharedReplayBuffer {
+    public:
+        // guards `buffer` for as long as this object lives, `stride` is the number of cars in each chunk
+        SharedReplayBuffer(ReplayBuffer& buffer, size_t stride) : buffer(buffer) {
+            buffer.setStride(stride);
+        }
+
+        void add(const ReplayBuffer& chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer.append(chunk);
+        }
+
+        void sample(size_t batchSize, const FeatureTable& table, ReplayBatch& batch, double beta = 1.0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer.sample(batchSize, table, batch, beta);
+        }
+
+        // slots may have been overwritten by actors since they were sampled, the
+        // new transition then simply takes over the priority
+        void updatePriorities(const size_t* idx, const double* td_errors, size_t n) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer.updatePriorities(idx, td_errors, n);
+        }
+
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return buffer.size();
+        }
+
+        // added() and the sampling generator of the buffer, read together for a snapshot
+        void position(uint64_t& added, std::mt19937& generator) {
+            std::lock_guard<std::mutex> lock(mutex);
+            added = buffer.added();
+            generator = buffer.generator();
+        }
+
+    private:
+        std::mutex mutex;
+        ReplayBuffer& buffer;
 };
@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <iostream>
 #include "../Utils.h"
@@ -29,23 +31,38 @@ public:
       : x(x), y(y), direction(dir), speed(spd),
         distU(distU), distR(distR), distD(distD), distL(distL), distG(distG) {}
 
-      std::vector<double> toVector() const {
-        double normX = static_cast<double>(x) / MAP_WIDTH;
-        double normY = static_cast<double>(y) / MAP_HEIGHT;
-        double normDirection = static_cast<double>(static_cast<int>(direction)) / 3.0;
-        double normSpeed = static_cast<double>(speed - 1) / 4.0;
-    
-       // Normalize distances to range [0, 1]
-        double normDistU = std::min(1.00, static_cast<double>(distU) / 15);
-        double normDistR = std::min(1.00, static_cast<double>(distR) / 15);
-        double normDistD = std::min(1.00, static_cast<double>(distD) / 15);
-        double normDistL = std::min(1.00, static_cast<double>(distL) / 15);
-        double normDistG = std::min(1.00, static_cast<double>(distG) / std::max(MAP_HEIGHT, MAP_WIDTH));
-    
-        return {normX, normY, normDirection, normSpeed, normDistU, normDistR, normDistD, normDistL, normDistG};
+      static constexpr int NUM_FEATURES = 9;
+
+      // features are computed in double and rounded to the network's scalar type
+      template <typename T = double>
+      std::vector<T> toVector() const {
+        std::vector<T> features(NUM_FEATURES);
+        writeFeatures(features.data());
+        return features;
+    }
+
+      // same encoding written to out[0..NUM_FEATURES), no allocation
+      template <typename T>
+      void writeFeatures(T* out) const {
+        out[0] = static_cast<T>(normX(x));
+        out[1] = static_cast<T>(normY(y));
+        out[2] = static_cast<T>(normDirection(direction));
+        out[3] = static_cast<T>(normSpeed(speed));
+        out[4] = static_cast<T>(normWall(distU));
+        out[5] = static_cast<T>(normWall(distR));
+        out[6] = static_cast<T>(normWall(distD));
+        out[7] = static_cast<T>(normWall(distL));
+        out[8] = static_cast<T>(normGoal(distG));
     }
-    
 
+    // feature normalization, shared with FeatureTable
+    static double normX(int x) { return static_cast<double>(x) / MAP_WIDTH; }
+    static double normY(int y) { return static_cast<double>(y) / MAP_HEIGHT; }
+    static double normDirection(Direction d) { return static_cast<double>(static_cast<int>(d)) / 3.0; }
+    static double normSpeed(int speed) { return static_cast<double>(speed - 1) / 4.0; }
+    // distances to range [0, 1]
+    static double normWall(int dist) { return std::min(1.00, static_cast<double>(dist) / 15); }
+    static double normGoal(int dist) { return std::min(1.00, static_cast<double>(dist) / std::max(MAP_HEIGHT, MAP_WIDTH)); }
 
     static State fromVector(const std::vector<double>& vec, int maxX, int maxY) {
         if (vec.size() != 4) throw std::invalid_argument("State vector must have 4 elements.");
@@ -70,6 +87,87 @@ public:
     }
 };
 
+// Position, direction and speed of a state in 32 bits (12 + 12 + 2 + 3). The
+// wall and goal distances are a function of the position on a static map, so
+// a FeatureTable restores the full encoding from this.
+static_assert(MAP_WIDTH <= 4096 && MAP_HEIGHT <= 4096, "packed states hold 12-bit coordinates");
+
+inline uint32_t packState(int x, int y, Direction dir, int speed) {
+    return static_cast<uint32_t>(x) | static_cast<uint32_t>(y) << 12
+         | static_cast<uint32_t>(dir) << 24 | static_cast<uint32_t>(speed) << 26;
+}
+
+inline uint32_t packState(const State& s) { return packState(s.x, s.y, s.direction, s.speed); }
+
+// the distances are left at 0
+inline State unpackState(uint32_t packed) {
+    return State(packed & 0xfff, (packed >> 12) & 0xfff, static_cast<Direction>((packed >> 24) & 3), (packed >> 26) & 7);
+}
+
+// The position-dependent features (x, y, wall and goal distances) of every
+// cell, normalized once. A row is padded to 8 doubles, one cache line, so
+// encoding a state is one row read plus direction and speed. Only valid for
+// states whose distances come from the map the table was built from.
+class FeatureTable {
+public:
+    // cellState(x, y) returns the State of a car standing on (x, y)
+    template <typename CellState>
+    void build(int w, int h, CellState cellState) {
+        width = w;
+        height = h;
+        rows.assign(static_cast<size_t>(w) * h * ROW, 0.0);
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const State s = cellState(x, y);
+                double* row = rows.data() + (static_cast<size_t>(y) * w + x) * ROW;
+                row[0] = State::normX(s.x);
+                row[1] = State::normY(s.y);
+                row[2] = State::normWall(s.distU);
+                row[3] = State::normWall(s.distR);
+                row[4] = State::normWall(s.distD);
+                row[5] = State::normWall(s.distL);
+                row[6] = State::normGoal(s.distG);
+            }
+        }
+    }
+
+    bool empty() const { return rows.empty(); }
+
+    // same values as state.writeFeatures(out)
+    template <typename T>
+    void encode(const State& state, T* out) const {
+        if (state.x < 0 || state.x >= width || state.y < 0 || state.y >= height) {
+            state.writeFeatures(out);
+            return;
+        }
+        const double* row = rows.data() + (static_cast<size_t>(state.y) * width + state.x) * ROW;
+        out[0] = static_cast<T>(row[0]);
+        out[1] = static_cast<T>(row[1]);
+        out[2] = static_cast<T>(State::normDirection(state.direction));
+        out[3] = static_cast<T>(State::normSpeed(state.speed));
+        for (int i = 0; i < 5; ++i) out[4 + i] = static_cast<T>(row[2 + i]);
+    }
+
+    // same as encode() for a packed state, which must lie inside the table
+    template <typename T>
+    void encodePacked(uint32_t packed, T* out) const {
+        const int x = packed & 0xfff;
+        const int y = (packed >> 12) & 0xfff;
+        const double* row = rows.data() + (static_cast<size_t>(y) * width + x) * ROW;
+        out[0] = static_cast<T>(row[0]);
+        out[1] = static_cast<T>(row[1]);
+        out[2] = static_cast<T>(State::normDirection(static_cast<Direction>((packed >> 24) & 3)));
+        out[3] = static_cast<T>(State::normSpeed((packed >> 26) & 7));
+        for (int i = 0; i < 5; ++i) out[4 + i] = static_cast<T>(row[2 + i]);
+    }
+
+private:
+    static constexpr int ROW = 8;
+    int width = 0;
+    int height = 0;
+    std::vector<double> rows;
+};
+
 struct ReplayRecord {
     State state;
     Action action;
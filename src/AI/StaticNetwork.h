@@ -0,0 +1,254 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "Kernels.h"
+#include "NeuralNetwork.h"
+#include "../Log.h"
+
+// GCC/Clang vector of T spanning `Bytes`, sized to one register of the target it is compiled for
+template <typename T, int Bytes> struct StaticVector {
+    typedef T type __attribute__((vector_size(Bytes)));
+};
+
+// Inference engine for a topology fixed at compile time, e.g.
+// StaticNetwork<double, 9, 128, 128, 6>. Every loop bound is a constant, so
+// each layer is fully unrolled into register tiles of accumulators, and the
+// parameters live inside the object in the padded ParameterArena /
+// checkpoint layout. The pass is compiled once per instruction set and picked
+// to match kernels<Scalar>(), so RL_KERNELS applies here too. Loads and saves
+// the same .rlck files as NeuralNetwork and can copy the weights of a
+// NeuralNetwork with the same layer sizes.
+// The object holds every parameter, allocate large ones on the heap.
+template <typename Scalar, int... Sizes>
+class StaticNetwork {
+public:
+    static constexpr int numLayers = static_cast<int>(sizeof...(Sizes)) - 1;
+    static constexpr std::array<int, sizeof...(Sizes)> sizes = {Sizes...};
+    static_assert(numLayers >= 1, "a network needs an input and an output size");
+
+    static constexpr int inputSize() { return sizes.front(); }
+    static constexpr int outputSize() { return sizes.back(); }
+
+    // Q-values of one encoded state, out holds outputSize() values
+    void forward(const Scalar* input, Scalar* out) const {
+        static const ForwardFn pass = selectForward();
+        pass(params.data(), input, out);
+    }
+
+    // `count` states stored row by row, out receives a [count x outputSize()] matrix
+    void forwardBatch(const Scalar* inputs, int count, Scalar* out) const {
+        for (int i = 0; i < count; ++i) {
+            forward(inputs + static_cast<size_t>(i) * inputSize(), out + static_cast<size_t>(i) * outputSize());
+        }
+    }
+
+    // true when `network` has exactly these layer sizes
+    template <typename MomentScalar>
+    static bool matches(const NeuralNetworkT<Scalar, MomentScalar>& network) {
+        const auto& layers = network.getLayers();
+        return shapesMatch(static_cast<int>(layers.size()), [&](int l) { return layers[l].inputSize(); },
+                           [&](int l) { return layers[l].outputSize(); });
+    }
+
+    template <typename MomentScalar>
+    bool copyFrom(const NeuralNetworkT<Scalar, MomentScalar>& source) {
+        const auto& layers = source.getLayers();
+        if (!matches(source)) {
+            LOG_ERROR("Error: network layer sizes do not match the static topology");
+            return false;
+        }
+        for (int l = 0; l < numLayers; ++l) {
+            std::copy(layers[l].weights.begin(), layers[l].weights.end(), params.begin() + weightsOffset(l));
+            std::copy(layers[l].biases.begin(), layers[l].biases.end(), params.begin() + biasesOffset(l));
+        }
+        return true;
+    }
+
+    bool loadCheckpoint(const std::string& file_path) {
+        MappedCheckpoint checkpoint;
+        if (!checkpoint.open(file_path)) return false;
+
+        const CheckpointHeader& h = checkpoint.header();
+        if (!shapesMatch(static_cast<int>(h.num_layers), [&](int l) { return checkpoint.layer(l).n_inputs; },
+                         [&](int l) { return checkpoint.layer(l).n_outputs; })) {
+            LOG_ERROR("Error: layer sizes in " << file_path << " do not match the static topology");
+            return false;
+        }
+
+        if (h.scalar_bytes == sizeof(Scalar)) {
+            // same padded layout, the whole section is one copy
+            checkpointReadElements(checkpoint.params(), h.scalar_bytes, params.data(), params.size());
+        } else {
+            const unsigned char* src = static_cast<const unsigned char*>(checkpoint.params());
+            for (int l = 0; l < numLayers; ++l) {
+                const size_t nWeights = static_cast<size_t>(sizes[l]) * sizes[l + 1];
+                const size_t fileWeights = checkpoint.weightsOffset(l);
+                const size_t fileBiases = fileWeights + checkpointPadded(nWeights, h.scalar_bytes);
+                checkpointReadElements(src + fileWeights * h.scalar_bytes, h.scalar_bytes, params.data() + weightsOffset(l), nWeights);
+                checkpointReadElements(src + fileBiases * h.scalar_bytes, h.scalar_bytes, params.data() + biasesOffset(l), sizes[l + 1]);
+            }
+        }
+        return true;
+    }
+
+    // parameters only, like TargetNetwork::saveCheckpoint
+    bool saveCheckpoint(const std::string& file_path) const {
+        std::vector<CheckpointLayer> table;
+        for (int l = 0; l < numLayers; ++l) {
+            table.push_back({sizes[l], sizes[l + 1], l == numLayers - 1 ? 1 : 0, 0, 0, 0, 0, 0, 0, 0, 0});
+        }
+        CheckpointWriter writer;
+        return writer.begin(file_path, sizeof(Scalar), 0, table) && writer.beginSection()
+            && writer.writeBlock(params.data(), params.size(), sizeof(Scalar)) && writer.finish();
+    }
+
+private:
+    using ForwardFn = void (*)(const Scalar* params, const Scalar* input, Scalar* out);
+
+    static constexpr size_t padded(size_t n) {
+        const size_t line = 64 / sizeof(Scalar);
+        return (n + line - 1) / line * line;
+    }
+
+    static constexpr size_t weightsOffset(int layer) {
+        size_t offset = 0;
+        for (int l = 0; l < layer; ++l) {
+            offset += padded(static_cast<size_t>(sizes[l]) * sizes[l + 1]) + padded(sizes[l + 1]);
+        }
+        return offset;
+    }
+
+    static constexpr size_t biasesOffset(int layer) {
+        return weightsOffset(layer) + padded(static_cast<size_t>(sizes[layer]) * sizes[layer + 1]);
+    }
+
+    static constexpr int maxWidth() {
+        int width = 0;
+        for (int s : sizes) width = s > width ? s : width;
+        return width;
+    }
+
+    template <typename InputSize, typename OutputSize>
+    static bool shapesMatch(int layerCount, InputSize in, OutputSize out) {
+        if (layerCount != numLayers) return false;
+        for (int l = 0; l < numLayers; ++l) {
+            if (in(l) != sizes[l] || out(l) != sizes[l + 1]) return false;
+        }
+        return true;
+    }
+
+    // `Count` accumulator vectors of outputs starting at vector v0, accumulated
+    // over every input in registers and written once
+    template <int VecBytes, int Count, int nIn, int nOut, bool relu>
+    static inline __attribute__((always_inline)) void denseTile(const Scalar* in, const Scalar* weights,
+                                                                const Scalar* biases, Scalar* dst, int v0) {
+        using Vec = typename StaticVector<Scalar, VecBytes>::type;
+        constexpr int LANES = VecBytes / sizeof(Scalar);
+        Vec acc[Count];
+        #pragma GCC unroll 16
+        for (int t = 0; t < Count; ++t) std::memcpy(&acc[t], biases + (v0 + t) * LANES, sizeof(Vec));
+        for (int i = 0; i < nIn; ++i) {
+            if (in[i] == Scalar(0)) continue; // ReLU activations are often zero
+            const Vec x = Vec{} + in[i];
+            const Scalar* row = weights + static_cast<size_t>(i) * nOut + v0 * LANES;
+            #pragma GCC unroll 16
+            for (int t = 0; t < Count; ++t) {
+                Vec w;
+                std::memcpy(&w, row + t * LANES, sizeof(Vec));
+                acc[t] += x * w;
+            }
+        }
+        #pragma GCC unroll 16
+        for (int t = 0; t < Count; ++t) {
+            if constexpr (relu) acc[t] = acc[t] > 0 ? acc[t] : Vec{};
+            std::memcpy(dst + (v0 + t) * LANES, &acc[t], sizeof(Vec));
+        }
+    }
+
+    // One dense layer with compile-time shape, computed tile by tile. VecBytes is
+    // the register width of the target, 64 (AVX-512), 32 (AVX2) or 16 (SSE2), and
+    // Tile how many accumulators its register file holds with room left for the
+    // weights.
+    template <int VecBytes, int Tile, int nIn, int nOut, bool relu>
+    static inline __attribute__((always_inline)) void dense(const Scalar* in, const Scalar* weights,
+                                                            const Scalar* biases, Scalar* dst) {
+        constexpr int LANES = VecBytes / sizeof(Scalar);
+        if constexpr (nOut % LANES == 0) {
+            constexpr int vecs = nOut / LANES;
+            constexpr int tile = vecs < Tile ? vecs : Tile;
+            constexpr int whole = vecs / tile * tile;
+            for (int v0 = 0; v0 < whole; v0 += tile) {
+                denseTile<VecBytes, tile, nIn, nOut, relu>(in, weights, biases, dst, v0);
+            }
+            // a width that does not split into whole tiles, e.g. 160 doubles in AVX-512 tiles of 16 vectors
+            if constexpr (whole < vecs) {
+                denseTile<VecBytes, vecs - whole, nIn, nOut, relu>(in, weights, biases, dst, whole);
+            }
+        } else {
+            // narrow layers (the 6 Q-values): plain loops, still fully unrolled
+            Scalar acc[nOut];
+            for (int j = 0; j < nOut; ++j) acc[j] = biases[j];
+            for (int i = 0; i < nIn; ++i) {
+                if (in[i] == Scalar(0)) continue;
+#pragma GCC unroll 16
+                for (int j = 0; j < nOut; ++j) acc[j] += in[i] * weights[i * nOut + j];
+            }
+            for (int j = 0; j < nOut; ++j) dst[j] = relu && acc[j] < 0 ? Scalar(0) : acc[j];
+        }
+    }
+
+    template <int VecBytes, int Tile>
+    static inline __attribute__((always_inline)) void forwardBody(const Scalar* params, const Scalar* input, Scalar* out) {
+        alignas(64) Scalar a[maxWidth()];
+        alignas(64) Scalar b[maxWidth()];
+        propagate<VecBytes, Tile, 0>(params, input, a, b, out);
+    }
+
+    // layer L reads `in` and writes scratch row `a`, the last layer writes `out`
+    template <int VecBytes, int Tile, int L>
+    static inline __attribute__((always_inline)) void propagate(const Scalar* params, const Scalar* in,
+                                                                Scalar* a, Scalar* b, Scalar* out) {
+        constexpr bool isOut = L == numLayers - 1;
+        dense<VecBytes, Tile, sizes[L], sizes[L + 1], !isOut>(in, params + weightsOffset(L), params + biasesOffset(L),
+                                                        isOut ? out : a);
+        if constexpr (!isOut) {
+            propagate<VecBytes, Tile, L + 1>(params, a, b, a, out);
+        }
+    }
+
+    static void forwardGeneric(const Scalar* params, const Scalar* input, Scalar* out) {
+        forwardBody<16, 8>(params, input, out);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2,fma")))
+    static void forwardAVX2(const Scalar* params, const Scalar* input, Scalar* out) {
+        forwardBody<32, 8>(params, input, out);
+    }
+
+    __attribute__((target("avx512f")))
+    static void forwardAVX512(const Scalar* params, const Scalar* input, Scalar* out) {
+        forwardBody<64, 16>(params, input, out);
+    }
+#endif
+
+    static ForwardFn selectForward() {
+#if defined(__x86_64__) || defined(__i386__)
+        const std::string selected = kernels<Scalar>().name;
+        if (selected == "avx512") return forwardAVX512;
+        if (selected == "avx2") return forwardAVX2;
+#endif
+        return forwardGeneric;
+    }
+
+    alignas(64) std::array<Scalar, weightsOffset(numLayers)> params{};
+};
+
+// the topology trained by game_main.cpp
+using ProductionNetwork = StaticNetwork<net_scalar, 9, 128, 128, 6>;
@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Binary tree over `capacity` non-negative values: every node holds the sum
+// and the minimum of its subtree, so updating a value, the running total and
+// finding the slot that owns a given prefix sum are all O(log n). Parents are
+// recomputed from their children on every update, so the sums do not drift.
+class SumTree {
+public:
+    explicit SumTree(size_t capacity = 0) { reset(capacity); }
+
+    void reset(size_t capacity) {
+        leaves = 1;
+        while (leaves < capacity) leaves *= 2;
+        sums.assign(2 * leaves, 0.0);
+        mins.assign(2 * leaves, std::numeric_limits<double>::infinity());
+    }
+
+    void set(size_t i, double value) {
+        size_t node = i + leaves;
+        sums[node] = value;
+        mins[node] = value;
+        for (node /= 2; node >= 1; node /= 2) {
+            sums[node] = sums[2 * node] + sums[2 * node + 1];
+            mins[node] = std::min(mins[2 * node], mins[2 * node + 1]);
+        }
+    }
+
+    double get(size_t i) const { return sums[i + leaves]; }
+    double total() const { return sums[1]; }
+    // smallest value set so far, infinity while empty
+    double min() const { return mins[1]; }
+
+    // slot i where the sum of values before it is <= prefix < that sum plus value i
+    size_t find(double prefix) const {
+        size_t node = 1;
+        while (node < leaves) {
+            const size_t left = 2 * node;
+            if (prefix < sums[left] || sums[left + 1] == 0.0) {
+                node = left;
+            } else {
+                prefix -= sums[left];
+                node = left + 1;
+            }
+        }
+        return node - leaves;
+    }
+
+private:
+    size_t leaves = 1;
+    std::vector<double> sums;
+    std::vector<double> mins;
+};
@@ -0,0 +1,100 @@
+#include "TargetNetwork.h"
+#include "Checkpoint.h"
+#include "../Log.h"
+#include <fstream>
+#include <iostream>
+
+template <typename Scalar>
+const Scalar* TargetNetworkT<Scalar>::forward(const Scalar* inputs, int count, InferenceWorkspace<Scalar>& workspace) const {
+    const Scalar* activations = inputs;
+    for (const auto& layer : layers) {
+        size_t needed = static_cast<size_t>(count) * layer.n_outputs;
+        if (workspace.next.size() < needed) workspace.next.resize(needed);
+        denseForward(activations, count, layer.weights.data(), layer.biases.data(),
+                     layer.n_inputs, layer.n_outputs, layer.isOut, workspace.next.data());
+        std::swap(workspace.current, workspace.next);
+        activations = workspace.current.data();
+    }
+    return activations;
+}
+
+template <typename Scalar>
+void TargetNetworkT<Scalar>::blend(Scalar* target, const Scalar* source, size_t n, double tau) {
+    const Scalar t = static_cast<Scalar>(tau);
+    for (size_t i = 0; i < n; ++i) {
+        target[i] += t * (source[i] - target[i]);
+    }
+}
+
+template <typename Scalar>
+void TargetNetworkT<Scalar>::save(const std::string& path) const {
+    LOG_INFO("Saving target network to directory: " << path);
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const DenseParams& layer = layers[l];
+        std::ofstream outFile(path + "/layer" + std::to_string(l) + ".txt");
+        if (!outFile.is_open()) {
+            LOG_ERROR("Could not open file for saving: " << path << "/layer" << l << ".txt");
+            return;
+        }
+
+        for (int i = 0; i < layer.n_inputs; ++i) {
+            for (int j = 0; j < layer.n_outputs; ++j) {
+                outFile << layer.weights[i * layer.n_outputs + j] << " ";
+            }
+            outFile << "\n";
+        }
+        for (int j = 0; j < layer.n_outputs; ++j) {
+            outFile << layer.biases[j] << " ";
+        }
+        outFile << "\n";
+    }
+    LOG_INFO("Target network saved.");
+}
+
+template <typename Scalar>
+bool TargetNetworkT<Scalar>::saveCheckpoint(const std::string& file_path) const {
+    std::vector<CheckpointLayer> table;
+    for (const auto& layer : layers) {
+        table.push_back({layer.n_inputs, layer.n_outputs, layer.isOut ? 1 : 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    }
+
+    CheckpointWriter writer;
+    bool ok = writer.begin(file_path, sizeof(Scalar), 0, table) && writer.beginSection();
+    for (const auto& layer : layers) {
+        ok = ok && writer.writeBlock(layer.weights.data(), layer.weights.size(), sizeof(Scalar))
+                && writer.writeBlock(layer.biases.data(), layer.biases.size(), sizeof(Scalar));
+    }
+    ok = ok && writer.finish();
+    if (ok) LOG_INFO("Target network saved to " << file_path);
+    return ok;
+}
+
+template <typename Scalar>
+bool TargetNetworkT<Scalar>::loadCheckpoint(const std::string& file_path) {
+    MappedCheckpoint checkpoint;
+    if (!checkpoint.open(file_path)) return false;
+
+    const CheckpointHeader& h = checkpoint.header();
+    bool shapesMatch = h.num_layers == layers.size();
+    for (size_t i = 0; shapesMatch && i < layers.size(); ++i) {
+        shapesMatch = checkpoint.layer(i).n_inputs == layers[i].n_inputs && checkpoint.layer(i).n_outputs == layers[i].n_outputs;
+    }
+    if (!shapesMatch) {
+        LOG_ERROR("Error: layer sizes in " << file_path << " do not match the target network");
+        return false;
+    }
+
+    const unsigned char* params = static_cast<const unsigned char*>(checkpoint.params());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        DenseParams& layer = layers[i];
+        const size_t weights = checkpoint.weightsOffset(i);
+        const size_t biases = weights + checkpointPadded(layer.weights.size(), h.scalar_bytes);
+        checkpointReadElements(params + weights * h.scalar_bytes, h.scalar_bytes, layer.weights.data(), layer.weights.size());
+        checkpointReadElements(params + biases * h.scalar_bytes, h.scalar_bytes, layer.biases.data(), layer.biases.size());
+    }
+    LOG_INFO("Target network loaded from " << file_path);
+    return true;
+}
+
+template class TargetNetworkT<double>;
+template class TargetNetworkT<float>;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "NeuralNetwork.h"
+
+// Inference-only copy of a Q-network used for the bootstrap targets.
+// Holds weights and biases only: no gradients, activations or Adam moments.
+template <typename Scalar>
+class TargetNetworkT {
+public:
+    template <typename MomentScalar>
+    explicit TargetNetworkT(const NeuralNetworkT<Scalar, MomentScalar>& source) {
+        for (const auto& layer : source.getLayers()) {
+            DenseParams params;
+            params.n_inputs = layer.inputSize();
+            params.n_outputs = layer.outputSize();
+            params.isOut = layer.isOutput();
+            params.weights.assign(layer.weights.begin(), layer.weights.end());
+            params.biases.assign(layer.biases.begin(), layer.biases.end());
+            layers.push_back(std::move(params));
+        }
+    }
+
+    // hard sync, copies into the storage allocated at construction
+    template <typename MomentScalar>
+    void copyFrom(const NeuralNetworkT<Scalar, MomentScalar>& source) {
+        const auto& sourceLayers = source.getLayers();
+        for (size_t l = 0; l < layers.size(); ++l) {
+            std::copy(sourceLayers[l].weights.begin(), sourceLayers[l].weights.end(), layers[l].weights.begin());
+            std::copy(sourceLayers[l].biases.begin(), sourceLayers[l].biases.end(), layers[l].biases.begin());
+        }
+    }
+
+    // Polyak update: target = (1 - tau) * target + tau * source
+    template <typename MomentScalar>
+    void softUpdate(const NeuralNetworkT<Scalar, MomentScalar>& source, double tau) {
+        const auto& sourceLayers = source.getLayers();
+        for (size_t l = 0; l < layers.size(); ++l) {
+            blend(layers[l].weights.data(), sourceLayers[l].weights.data(), layers[l].weights.size(), tau);
+            blend(layers[l].biases.data(), sourceLayers[l].biases.data(), layers[l].biases.size(), tau);
+        }
+    }
+
+    const Scalar* forward(const Scalar* inputs, int count, InferenceWorkspace<Scalar>& workspace) const;
+    int inputSize() const { return layers.front().n_inputs; }
+    int outputSize() const { return layers.back().n_outputs; }
+
+    // writes layerN.txt in the same format as Layer::save
+    void save(const std::string& directory_path) const;
+    // binary .rlck checkpoint without optimizer sections, loadable by NeuralNetwork
+    bool saveCheckpoint(const std::string& file_path) const;
+    // parameters of any .rlck checkpoint with the same layer sizes, the optimizer sections are ignored
+    bool loadCheckpoint(const std::string& file_path);
+
+private:
+    struct DenseParams {
+        int n_inputs;
+        int n_outputs;
+        bool isOut;
+        AlignedVector<Scalar> weights;
+        AlignedVector<Scalar> biases;
+    };
+
+    static void blend(Scalar* target, const Scalar* source, size_t n, double tau);
+
+    std::vector<DenseParams> layers;
+};
+
+using TargetNetwork = TargetNetworkT<net_scalar>;
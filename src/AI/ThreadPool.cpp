@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+#include <cstdlib>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+ThreadPool::ThreadPool(int numThreads) {
+    for (int i = 1; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(int count, const std::function<void(int)>& task) {
+    if (count <= 0) return;
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(runMutex);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        currentTask = &task;
+        taskCount = count;
+        nextIndex.store(0);
+        busyWorkers = static_cast<int>(workers.size());
+        ++generation;
+    }
+    wake.notify_all();
+
+    drain();
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    finished.wait(lock, [this] { return busyWorkers == 0; });
+    currentTask = nullptr;
+}
+
+void ThreadPool::drain() {
+    for (int i = nextIndex.fetch_add(1); i < taskCount; i = nextIndex.fetch_add(1)) {
+        (*currentTask)(i);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--busyWorkers == 0) finished.notify_one();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool([] {
+        int threads = static_cast<int>(std::thread::hardware_concurrency());
+#ifdef __linux__
+        // only the cores this process may run on (taskset, bench --cpu)
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) threads = CPU_COUNT(&allowed);
+#endif
+        if (const char* forced = std::getenv("RL_THREADS")) {
+            threads = std::atoi(forced);
+        }
+        if (threads < 1) threads = 1;
+        return threads;
+    }());
+    return pool;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. run() hands out task
+// indices to the workers and the calling thread and returns once all are done.
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threads taking part in run(), the caller included
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // calls task(i) once for every i in [0, count); concurrent run() calls are serialized
+    void run(int count, const std::function<void(int)>& task);
+
+    // process-wide pool, sized by RL_THREADS or the cores the process may run on when first used
+    static ThreadPool& shared();
+
+private:
+    void workerLoop();
+    void drain();
+
+    std::vector<std::thread> workers;
+    std::mutex runMutex;   // one run() at a time
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    const std::function<void(int)>* currentTask = nullptr;
+    int taskCount = 0;
+    std::atomic<int> nextIndex{0};
+    int busyWorkers = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+};
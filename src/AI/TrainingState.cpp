@@ -0,0 +1,91 @@
+#include "TrainingState.h"
+#include "../Log.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+bool writeGenerator(std::FILE* file, const std::mt19937& generator) {
+    std::ostringstream out;
+    out << generator;
+    const std::string text = out.str();
+    const uint32_t length = static_cast<uint32_t>(text.size());
+    return std::fwrite(&length, sizeof(length), 1, file) == 1
+        && std::fwrite(text.data(), 1, text.size(), file) == text.size();
+}
+
+bool readGenerator(std::FILE* file, std::mt19937& generator) {
+    uint32_t length = 0;
+    // a mt19937 state is 624 numbers of at most 10 digits
+    if (std::fread(&length, sizeof(length), 1, file) != 1 || length > 16384) return false;
+    std::string text(length, '\0');
+    if (std::fread(&text[0], 1, length, file) != length) return false;
+    std::istringstream in(text);
+    in >> generator;
+    return !in.fail();
+}
+
+} // namespace
+
+bool saveTrainingState(const std::string& file_path, const TrainingState& state) {
+    const std::string tmpPath = file_path + ".tmp";
+    std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR("Could not open file for saving: " << tmpPath);
+        return false;
+    }
+
+    TrainingStateHeader header{};
+    std::memcpy(header.magic, TRAINING_STATE_MAGIC, sizeof(header.magic));
+    header.version = TRAINING_STATE_VERSION;
+    header.episode = static_cast<uint64_t>(state.episode);
+    header.learn_steps = state.learn_steps;
+    header.replay_added = state.replay_added;
+    header.epsilon = state.epsilon;
+    header.best_distance = state.best_distance;
+    header.num_generators = 3;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && writeGenerator(file, state.agent_rng)
+        && writeGenerator(file, state.replay_rng)
+        && writeGenerator(file, state.start_rng);
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(tmpPath.c_str(), file_path.c_str()) != 0) {
+        LOG_ERROR("Error: could not write training state " << file_path);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadTrainingState(const std::string& file_path, TrainingState& state) {
+    std::FILE* file = std::fopen(file_path.c_str(), "rb");
+    if (!file) {
+        LOG_ERROR("Could not open training state " << file_path);
+        return false;
+    }
+
+    TrainingStateHeader header{};
+    TrainingState loaded;
+    const bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+        && std::memcmp(header.magic, TRAINING_STATE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == TRAINING_STATE_VERSION
+        && header.num_generators == 3
+        && readGenerator(file, loaded.agent_rng)
+        && readGenerator(file, loaded.replay_rng)
+        && readGenerator(file, loaded.start_rng);
+    std::fclose(file);
+    if (!ok) {
+        LOG_ERROR(file_path << " is not a training state (version " << TRAINING_STATE_VERSION << ")");
+        return false;
+    }
+
+    loaded.episode = static_cast<int>(header.episode);
+    loaded.learn_steps = header.learn_steps;
+    loaded.replay_added = header.replay_added;
+    loaded.epsilon = header.epsilon;
+    loaded.best_distance = header.best_distance;
+    state = loaded;
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include "../Utils.h"
+
+// Binary training state (.rlts): everything besides the networks and the
+// replay memory that a run needs to continue where it stopped, including how
+// far the replay memory had got.
+//
+//   TrainingStateHeader                     64 bytes
+//   per generator: uint32 length, then the std::mt19937 state as written by operator<<
+//
+// The file is written next to its destination and renamed into place like a
+// checkpoint, so a crash keeps the previous state.
+
+static const char TRAINING_STATE_MAGIC[4] = {'R', 'L', 'T', 'S'};
+static const uint32_t TRAINING_STATE_VERSION = 2;
+
+struct TrainingStateHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t episode;
+    uint64_t learn_steps;
+    double epsilon;
+    int32_t best_distance;
+    uint32_t num_generators;
+    uint64_t replay_added;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(TrainingStateHeader) == 64, "training state header must stay 64 bytes");
+
+struct TrainingState {
+    int episode = 0;                          // next episode to run
+    int best_distance = MAP_HEIGHT * MAP_WIDTH;
+    double epsilon = 1.0;
+    uint64_t learn_steps = 0;
+    uint64_t replay_added = 0;               // ReplayBuffer::added() at the snapshot
+    std::mt19937 agent_rng{std::random_device{}()};  // epsilon-greedy choices
+    std::mt19937 replay_rng{std::random_device{}()}; // replay sampling
+    std::mt19937 start_rng{std::random_device{}()};  // random start cells
+};
+
+bool saveTrainingState(const std::string& file_path, const TrainingState& state);
+// prints the reason and returns false on failure
+bool loadTrainingState(const std::string& file_path, TrainingState& state);
@@ -0,0 +1,301 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace logging {
+
+namespace {
+
+int initialThreshold() {
+    const char* env = std::getenv("RL_LOG_LEVEL");
+    if (!env) return static_cast<int>(LogLevel::Info);
+    const std::string value = env;
+    if (value == "debug") return static_cast<int>(LogLevel::Debug);
+    if (value == "info") return static_cast<int>(LogLevel::Info);
+    if (value == "warn") return static_cast<int>(LogLevel::Warn);
+    if (value == "error") return static_cast<int>(LogLevel::Error);
+    if (value == "off") return static_cast<int>(LogLevel::Off);
+    std::cerr << "RL_LOG_LEVEL=" << value << " is not a log level, using info" << std::endl;
+    return static_cast<int>(LogLevel::Info);
+}
+
+class ConsoleSink : public Sink {
+public:
+    void write(LogLevel level, const std::string& line) override {
+        (level >= LogLevel::Warn ? std::cerr : std::cout) << line << '\n';
+    }
+    void flush() override {
+        std::cout.flush();
+        std::cerr.flush();
+    }
+};
+
+class FileSink : public Sink {
+public:
+    explicit FileSink(const std::string& path) : file(path, std::ios::app) {
+        if (!file) std::cerr << "Could not open log file " << path << std::endl;
+    }
+    void write(LogLevel, const std::string& line) override { file << line << '\n'; }
+    void flush() override { file.flush(); }
+
+private:
+    std::ofstream file;
+};
+
+// Byte ring written only by its owning thread and read only by the drainer.
+// Records are an 8 byte header (length, level) followed by the text. `dropped`
+// counts the messages that found the ring full since the last drain.
+struct ThreadRing {
+    static constexpr size_t CAPACITY = 1 << 16;
+    static constexpr size_t MAX_MESSAGE = CAPACITY / 4;
+
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<bool> owned{true};
+    std::atomic<size_t> dropped{0};
+    char data[CAPACITY];
+
+    void put(size_t pos, const void* src, size_t n) {
+        const size_t offset = pos % CAPACITY, first = std::min(n, CAPACITY - offset);
+        std::memcpy(data + offset, src, first);
+        std::memcpy(data, static_cast<const char*>(src) + first, n - first);
+    }
+    void get(size_t pos, void* dst, size_t n) const {
+        const size_t offset = pos % CAPACITY, first = std::min(n, CAPACITY - offset);
+        std::memcpy(dst, data + offset, first);
+        std::memcpy(static_cast<char*>(dst) + first, data, n - first);
+    }
+};
+
+class Logger {
+public:
+    Logger() {
+        sinks.push_back(consoleSink());
+        if (const char* file = std::getenv("RL_LOG_FILE")) sinks.push_back(fileSink(file));
+        worker = std::thread([this] { run(); });
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+        drain();
+    }
+
+    void push(LogLevel level, const char* text, size_t length) {
+        ThreadRing& ring = threadRing();
+        const uint32_t header[2] = {static_cast<uint32_t>(std::min(length, ThreadRing::MAX_MESSAGE)),
+                                    static_cast<uint32_t>(level)};
+        const size_t need = sizeof(header) + header[0];
+
+        const size_t head = ring.head.load(std::memory_order_relaxed);
+        if (ThreadRing::CAPACITY - (head - ring.tail.load(std::memory_order_acquire)) < need) {
+            if (level < LogLevel::Error) {
+                // full: the drainer fell behind, losing the line beats stalling the caller
+                ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                wake.notify_one();
+                return;
+            }
+            drain(); // errors are never dropped, this empties the thread's ring
+        }
+        ring.put(head, header, sizeof(header));
+        ring.put(head + sizeof(header), text, header[0]);
+        ring.head.store(head + need, std::memory_order_release);
+
+        if (level >= LogLevel::Error) {
+            drain();
+        } else if (head + need - ring.tail.load(std::memory_order_relaxed) > ThreadRing::CAPACITY / 2) {
+            wake.notify_one();
+        }
+    }
+
+    // writes every queued record to the sinks, safe to call from any thread
+    void drain() {
+        std::lock_guard<std::mutex> drainLock(drainMutex);
+        std::vector<ThreadRing*> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for (auto& ring : rings) snapshot.push_back(ring.get());
+        }
+
+        std::lock_guard<std::mutex> sinkLock(sinksMutex);
+        bool wrote = false;
+        for (ThreadRing* ring : snapshot) {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            const size_t head = ring->head.load(std::memory_order_acquire);
+            while (tail != head) {
+                uint32_t header[2];
+                ring->get(tail, header, sizeof(header));
+                line.resize(header[0]);
+                ring->get(tail + sizeof(header), &line[0], header[0]);
+                for (auto& sink : sinks) sink->write(static_cast<LogLevel>(header[1]), line);
+                tail += sizeof(header) + header[0];
+                wrote = true;
+            }
+            ring->tail.store(tail, std::memory_order_release);
+
+            if (const size_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+                line = std::to_string(dropped) + " log messages dropped, the logging thread fell behind";
+                for (auto& sink : sinks) sink->write(LogLevel::Warn, line);
+                wrote = true;
+            }
+        }
+        if (wrote) {
+            for (auto& sink : sinks) sink->flush();
+        }
+    }
+
+    void addSink(std::unique_ptr<Sink> sink) {
+        std::lock_guard<std::mutex> lock(sinksMutex);
+        sinks.push_back(std::move(sink));
+    }
+
+    void clearSinks() {
+        drain();
+        std::lock_guard<std::mutex> lock(sinksMutex);
+        sinks.clear();
+    }
+
+private:
+    // hands the ring back for reuse when its thread exits
+    struct RingHandle {
+        ThreadRing* ring = nullptr;
+        ~RingHandle() {
+            if (ring) ring->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    ThreadRing& threadRing() {
+        thread_local RingHandle handle;
+        if (handle.ring) return *handle.ring;
+
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (auto& ring : rings) {
+            // a ring left by a finished thread, once the drainer has emptied it
+            if (!ring->owned.load(std::memory_order_acquire)
+                && ring->tail.load(std::memory_order_acquire) == ring->head.load(std::memory_order_relaxed)) {
+                ring->owned.store(true, std::memory_order_relaxed);
+                handle.ring = ring.get();
+                return *handle.ring;
+            }
+        }
+        rings.push_back(std::make_unique<ThreadRing>());
+        handle.ring = rings.back().get();
+        return *handle.ring;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopping) {
+            wake.wait_for(lock, std::chrono::milliseconds(20));
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+
+    std::mutex drainMutex;
+    std::string line; // drain scratch, guarded by drainMutex
+
+    std::mutex sinksMutex;
+    std::vector<std::unique_ptr<Sink>> sinks;
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread worker;
+};
+
+std::atomic<bool> loggerDestroyed{false};
+
+Logger& logger() {
+    struct Holder {
+        Logger instance;
+        ~Holder() { loggerDestroyed = true; }
+    };
+    static Holder holder;
+    return holder.instance;
+}
+
+// Put area of a thread's log lines. The storage is kept from line to line, so
+// formatting only allocates while the buffer grows to the thread's longest line.
+class LineBuffer : public std::streambuf {
+public:
+    LineBuffer() : storage(256) { reset(); }
+
+    void reset() { setp(storage.data(), storage.data() + storage.size()); }
+    const char* data() const { return pbase(); }
+    size_t size() const { return static_cast<size_t>(pptr() - pbase()); }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+        const size_t used = size();
+        storage.resize(storage.size() * 2);
+        setp(storage.data(), storage.data() + storage.size());
+        pbump(static_cast<int>(used));
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+        return ch;
+    }
+
+private:
+    std::vector<char> storage;
+};
+
+struct ThreadStream {
+    LineBuffer buffer;
+    std::ostream stream{&buffer};
+};
+
+ThreadStream& threadStream() {
+    thread_local ThreadStream stream;
+    return stream;
+}
+
+} // namespace
+
+std::atomic<int> threshold{initialThreshold()};
+
+std::unique_ptr<Sink> consoleSink() { return std::make_unique<ConsoleSink>(); }
+std::unique_ptr<Sink> fileSink(const std::string& path) { return std::make_unique<FileSink>(path); }
+
+void setLevel(LogLevel level) { threshold.store(static_cast<int>(level), std::memory_order_relaxed); }
+void addSink(std::unique_ptr<Sink> sink) { logger().addSink(std::move(sink)); }
+void clearSinks() { logger().clearSinks(); }
+void flush() { logger().drain(); }
+
+Line::Line(LogLevel level) : level(level), out(threadStream().stream) {
+    threadStream().buffer.reset();
+    out.clear();
+}
+
+Line::~Line() {
+    const LineBuffer& text = threadStream().buffer;
+    if (loggerDestroyed) {
+        // during static destruction, after the logging thread is gone
+        std::ostream& console = level >= LogLevel::Warn ? std::cerr : std::cout;
+        console.write(text.data(), static_cast<std::streamsize>(text.size()));
+        console << std::endl;
+        return;
+    }
+    logger().push(level, text.data(), text.size());
+}
+
+} // namespace logging
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// Leveled asynchronous logging. A message is formatted on the calling thread,
+// copied into that thread's ring buffer and written to the sinks by a
+// background thread, so logging never waits on the console or a file.
+// Messages below the threshold are not formatted at all, and levels below
+// RL_LOG_COMPILED_LEVEL (0 = debug ... 4 = off) compile to nothing. Lines of
+// one thread keep their order, lines of different threads are interleaved
+// per drain. A message that finds its thread's ring full is dropped and the
+// number of dropped messages is reported by the next drain; errors are never
+// dropped and are flushed before the logging call returns.
+//
+//   LOG_INFO("Network saved to " << file_path);
+//
+// RL_LOG_LEVEL=debug|info|warn|error|off sets the threshold (default info),
+// RL_LOG_FILE=<path> adds a file sink next to the console.
+
+enum class LogLevel { Debug = 0, Info = 1, Warn = 2, Error = 3, Off = 4 };
+
+#ifndef RL_LOG_COMPILED_LEVEL
+#define RL_LOG_COMPILED_LEVEL 0
+#endif
+
+namespace logging {
+
+// receives whole lines, without the newline, on the logging thread
+class Sink {
+public:
+    virtual ~Sink() = default;
+    virtual void write(LogLevel level, const std::string& line) = 0;
+    // called after every batch of lines
+    virtual void flush() {}
+};
+
+// debug and info to stdout, warnings and errors to stderr
+std::unique_ptr<Sink> consoleSink();
+// appends every line to `path`
+std::unique_ptr<Sink> fileSink(const std::string& path);
+
+extern std::atomic<int> threshold;
+
+inline bool enabled(LogLevel level) {
+    return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed);
+}
+
+void setLevel(LogLevel level);
+void addSink(std::unique_ptr<Sink> sink);
+void clearSinks();
+// blocks until every line logged so far has reached the sinks
+void flush();
+
+// One message: formats into a reused thread-local buffer and queues the line
+// when it goes out of scope. Use the LOG_* macros rather than this directly.
+class Line {
+public:
+    explicit Line(LogLevel level);
+    ~Line();
+    Line(const Line&) = delete;
+    Line& operator=(const Line&) = delete;
+    std::ostream& stream() { return out; }
+
+private:
+    LogLevel level;
+    std::ostream& out;
+};
+
+} // namespace logging
+
+#define RL_LOG(level, message)                                                                  \
+    do {                                                                                        \
+        if (static_cast<int>(level) >= RL_LOG_COMPILED_LEVEL && logging::enabled(level)) {      \
+            logging::Line rl_log_line(level);                                                   \
+            rl_log_line.stream() << message;                                                    \
+        }                                                                                       \
+    } while (0)
+
+#define LOG_DEBUG(message) RL_LOG(LogLevel::Debug, message)
+#define LOG_INFO(message) RL_LOG(LogLevel::Info, message)
+#define LOG_WARN(message) RL_LOG(LogLevel::Warn, message)
+#define LOG_ERROR(message) RL_LOG(LogLevel::Error, message)
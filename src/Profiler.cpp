@@ -0,0 +1,278 @@
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace profiler {
+
+namespace {
+
+int reportInterval() {
+    const char* env = std::getenv("RL_PROFILE");
+    return env ? std::max(1, std::atoi(env)) : 0;
+}
+
+constexpr int MAX_PHASES = 32;
+// 8 buckets per power of two: percentiles are within ~6% of the true value
+constexpr int SUB_BITS = 3;
+constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+int bucketOf(uint64_t ns) {
+    if (ns < SUB_BUCKETS) return static_cast<int>(ns);
+    const int top = 63 - __builtin_clzll(ns);
+    const int sub = static_cast<int>(ns >> (top - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (top - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+// middle of the durations counted by `bucket`
+double bucketValue(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    const int shift = bucket / SUB_BUCKETS - 1;
+    const double lower = static_cast<double>(SUB_BUCKETS + bucket % SUB_BUCKETS) * (uint64_t(1) << shift);
+    return lower + 0.5 * (uint64_t(1) << shift);
+}
+
+// written only by the owning thread, read by whichever thread reports
+struct PhaseCounts {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint32_t> buckets[BUCKETS];
+
+    PhaseCounts() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct TraceEvent {
+    int phase;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct ThreadState {
+    int tid = 0;
+    PhaseCounts phases[MAX_PHASES];
+    std::mutex traceMutex;
+    std::vector<TraceEvent> events;
+};
+
+inline void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class Profiler {
+public:
+    Profiler() : interval(reportInterval()), epoch(now()), lastReport(epoch) {
+        const char* tracePath = std::getenv("RL_TRACE_FILE");
+        if (!tracePath || !interval) return;
+        if (const char* limit = std::getenv("RL_TRACE_EVENTS")) maxEvents = std::strtoull(limit, nullptr, 10);
+        trace = std::fopen(tracePath, "w");
+        if (!trace) {
+            LOG_ERROR("Could not open trace file " << tracePath);
+            return;
+        }
+        std::fputs("[\n", trace);
+        tracing.store(true, std::memory_order_relaxed);
+        LOG_INFO("Writing a Chrome trace to " << tracePath);
+    }
+
+    int phaseId(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) return static_cast<int>(i);
+        }
+        if (names.size() == MAX_PHASES) {
+            LOG_WARN("More than " << MAX_PHASES << " profiled phases, not timing " << name);
+            return -1;
+        }
+        names.emplace_back(name);
+        return static_cast<int>(names.size()) - 1;
+    }
+
+    void record(int phase, uint64_t start, uint64_t end) {
+        if (phase < 0) return;
+        ThreadState& state = threadState();
+        PhaseCounts& counts = state.phases[phase];
+        const uint64_t duration = end - start;
+        bump(counts.calls, 1);
+        bump(counts.total, duration);
+        auto& bucket = counts.buckets[bucketOf(duration)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (!tracing.load(std::memory_order_relaxed)) return;
+        if (traced.fetch_add(1, std::memory_order_relaxed) >= maxEvents) {
+            tracing.store(false, std::memory_order_relaxed);
+            LOG_WARN("Trace reached " << maxEvents << " events (RL_TRACE_EVENTS), no longer tracing");
+            return;
+        }
+        std::lock_guard<std::mutex> lock(state.traceMutex);
+        state.events.push_back({phase, start, end});
+    }
+
+    void endEpisode(int episode) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++episodes < interval) return;
+        report(episode);
+        writeTrace();
+        episodes = 0;
+    }
+
+    void shutdown() {
+        std::lock_guard<std::mutex> lock(mutex);
+        tracing.store(false, std::memory_order_relaxed);
+        writeTrace();
+        if (trace) {
+            std::fputs("\n]\n", trace);
+            std::fclose(trace);
+            trace = nullptr;
+        }
+    }
+
+private:
+    ThreadState& threadState() {
+        thread_local ThreadState* local = nullptr;
+        if (!local) {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.push_back(std::make_unique<ThreadState>());
+            local = threads.back().get();
+            local->tid = static_cast<int>(threads.size());
+        }
+        return *local;
+    }
+
+    // differences against the counts of the previous report, mutex held
+    void report(int episode) {
+        const uint64_t time = now();
+        const double wall = static_cast<double>(time - lastReport);
+        lastReport = time;
+
+        struct Row {
+            size_t phase;
+            uint64_t calls;
+            uint64_t total;
+            double p50, p99;
+        };
+        std::vector<Row> rows;
+        if (previous.size() < names.size()) previous.resize(names.size());
+        std::vector<uint64_t> buckets(BUCKETS);
+        for (size_t p = 0; p < names.size(); ++p) {
+            Snapshot current;
+            current.buckets.assign(BUCKETS, 0);
+            for (const auto& state : threads) {
+                const PhaseCounts& counts = state->phases[p];
+                current.calls += counts.calls.load(std::memory_order_relaxed);
+                current.total += counts.total.load(std::memory_order_relaxed);
+                for (int b = 0; b < BUCKETS; ++b) current.buckets[b] += counts.buckets[b].load(std::memory_order_relaxed);
+            }
+            Snapshot& last = previous[p];
+            last.buckets.resize(BUCKETS, 0);
+            const uint64_t calls = current.calls - last.calls;
+            if (calls > 0) {
+                for (int b = 0; b < BUCKETS; ++b) buckets[b] = current.buckets[b] - last.buckets[b];
+                rows.push_back({p, calls, current.total - last.total, percentile(buckets, calls, 0.5),
+                                percentile(buckets, calls, 0.99)});
+            }
+            last = std::move(current);
+        }
+
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.total > b.total; });
+        LOG_INFO("⏱ Profile of episodes " << episode + 1 - episodes << "-" << episode
+                 << " (" << wall / 1e6 << " ms)");
+        for (const Row& row : rows) {
+            LOG_INFO("⏱   " << names[row.phase]
+                     << " | " << static_cast<double>(row.calls) / episodes << " calls/episode"
+                     << " | " << row.total / 1e6 / episodes << " ms/episode"
+                     << " | " << 100.0 * row.total / wall << "%"
+                     << " | p50 " << row.p50 / 1e3 << " us"
+                     << " | p99 " << row.p99 / 1e3 << " us");
+        }
+    }
+
+    static double percentile(const std::vector<uint64_t>& buckets, uint64_t calls, double q) {
+        const uint64_t rank = static_cast<uint64_t>(q * (calls - 1));
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen > rank) return bucketValue(b);
+        }
+        return bucketValue(BUCKETS - 1);
+    }
+
+    // events of every thread as trace-event JSON, mutex held
+    void writeTrace() {
+        if (!trace) return;
+        std::vector<TraceEvent> events;
+        for (const auto& state : threads) {
+            {
+                std::lock_guard<std::mutex> lock(state->traceMutex);
+                events.swap(state->events);
+            }
+            for (const TraceEvent& e : events) {
+                std::fprintf(trace, "%s{\"name\":\"%s\",\"cat\":\"rl\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                                    "\"ts\":%.3f,\"dur\":%.3f}",
+                             firstEvent ? "" : ",\n", names[e.phase].c_str(), state->tid,
+                             (e.start - epoch) / 1e3, (e.end - e.start) / 1e3);
+                firstEvent = false;
+            }
+            events.clear();
+        }
+        std::fflush(trace);
+    }
+
+    struct Snapshot {
+        uint64_t calls = 0;
+        uint64_t total = 0;
+        std::vector<uint64_t> buckets;
+    };
+
+    const int interval;
+    const uint64_t epoch;
+    uint64_t lastReport;
+    int episodes = 0;
+
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<ThreadState>> threads;
+    std::vector<Snapshot> previous;
+
+    std::FILE* trace = nullptr;
+    bool firstEvent = true;
+    std::atomic<bool> tracing{false};
+    std::atomic<uint64_t> traced{0};
+    uint64_t maxEvents = 1000000;
+};
+
+// never destroyed: worker threads may still record while static objects are torn down
+Profiler& instance() {
+    static Profiler* profiler = [] {
+        auto* p = new Profiler();
+        std::atexit([] { instance().shutdown(); });
+        return p;
+    }();
+    return *profiler;
+}
+
+} // namespace
+
+std::atomic<bool> active{reportInterval() > 0};
+
+int phaseId(const char* name) { return instance().phaseId(name); }
+
+void record(int phase, uint64_t start, uint64_t end) { instance().record(phase, start, end); }
+
+void endEpisode(int episode) {
+    if (enabled()) instance().endEpisode(episode);
+}
+
+void shutdown() {
+    if (enabled()) instance().shutdown();
+}
+
+} // namespace profiler
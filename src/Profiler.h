@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Scoped timers for the phases of a training step. PROFILE_SCOPE("name")
+// times the rest of the enclosing block under that phase name. Disabled (the
+// default) a scope costs a relaxed load and a branch, and building with
+// -DRL_PROFILE_COMPILED=0 removes the scopes altogether.
+//
+// Every thread counts its own calls into a log-linear histogram of durations
+// without locking. profiler::endEpisode() is called once per training
+// episode; every N-th episode it logs, per phase, the calls and time per
+// episode, the share of wall time and the p50/p99 of one call since the last
+// report. Nested phases are counted in full by each enclosing phase too, and
+// phases run by several threads can add up to more than the wall time.
+//
+//   RL_PROFILE=<N>          enables the timers and reports every N episodes
+//   RL_TRACE_FILE=<path>    also writes every timed scope as a Chrome trace
+//                           event, for chrome://tracing or ui.perfetto.dev
+//   RL_TRACE_EVENTS=<n>     stops tracing after n events (default 1000000)
+
+#ifndef RL_PROFILE_COMPILED
+#define RL_PROFILE_COMPILED 1
+#endif
+
+namespace profiler {
+
+extern std::atomic<bool> active;
+
+inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+inline uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// id of the phase called `name`, every call site of one name shares it
+int phaseId(const char* name);
+// one timed call of `phase` on this thread
+void record(int phase, uint64_t start, uint64_t end);
+
+// counts an episode and logs the report when one is due
+void endEpisode(int episode);
+// writes the buffered trace events and closes the trace, also done at exit
+void shutdown();
+
+class Scope {
+public:
+    explicit Scope(int phase) : phase(phase), start(enabled() ? now() : 0) {}
+    ~Scope() {
+        if (start) record(phase, start, now());
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    int phase;
+    uint64_t start;
+};
+
+} // namespace profiler
+
+#define RL_PROFILE_CONCAT_(a, b) a##b
+#define RL_PROFILE_CONCAT(a, b) RL_PROFILE_CONCAT_(a, b)
+
+#if RL_PROFILE_COMPILED
+#define PROFILE_SCOPE(name)                                                                   \
+    static const int RL_PROFILE_CONCAT(rl_profile_phase_, __LINE__) = ::profiler::phaseId(name); \
+    ::profiler::Scope RL_PROFILE_CONCAT(rl_profile_scope_, __LINE__)(RL_PROFILE_CONCAT(rl_profile_phase_, __LINE__))
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#endif
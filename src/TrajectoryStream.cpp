@@ -0,0 +1,148 @@
+#include "TrajectoryStream.h"
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t pack(int x, int y, uint32_t episode) {
+    return static_cast<uint64_t>(static_cast<uint16_t>(x))
+         | static_cast<uint64_t>(static_cast<uint16_t>(y)) << 16
+         | static_cast<uint64_t>(episode) << 32;
+}
+
+TrajectoryPoint unpack(uint64_t value) {
+    return {static_cast<uint16_t>(value), static_cast<uint16_t>(value >> 16), static_cast<uint32_t>(value >> 32)};
+}
+
+} // namespace
+
+TrajectoryWriter::~TrajectoryWriter() {
+    if (ring) munmap(ring, sizeof(TrajectoryRing));
+}
+
+bool TrajectoryWriter::open(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        LOG_WARN("Could not open trajectory stream " << name << ": " << std::strerror(errno));
+        return false;
+    }
+
+    // a segment left by an incompatible build is replaced
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size != 0 && st.st_size != static_cast<off_t>(sizeof(TrajectoryRing))) {
+        close(fd);
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            LOG_WARN("Could not recreate trajectory stream " << name << ": " << std::strerror(errno));
+            if (fd >= 0) close(fd);
+            return false;
+        }
+    }
+    if (st.st_size == 0 && ftruncate(fd, sizeof(TrajectoryRing)) != 0) {
+        LOG_WARN("Could not size trajectory stream " << name << ": " << std::strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, sizeof(TrajectoryRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG_WARN("Could not map trajectory stream " << name << ": " << std::strerror(errno));
+        return false;
+    }
+    ring = static_cast<TrajectoryRing*>(mapped);
+
+    if (ring->magic != TrajectoryRing::MAGIC || ring->version != TrajectoryRing::VERSION) {
+        // fresh, zero-filled segment
+        ring->reserved.store(0, std::memory_order_relaxed);
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->version = TrajectoryRing::VERSION;
+        ring->magic = TrajectoryRing::MAGIC;
+    } else {
+        // continue after the previous run so attached readers keep their position
+        ring->head.store(ring->reserved.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+    return true;
+}
+
+void TrajectoryWriter::publish(uint32_t episode, const std::vector<std::pair<int, int>>& path) {
+    if (!ring || path.empty()) return;
+    const size_t n = std::min(path.size(), TrajectoryRing::CAPACITY);
+    const size_t first = path.size() - n;
+    const uint64_t h = ring->head.load(std::memory_order_relaxed);
+
+    // readers discard anything they copied from slots below reserved - CAPACITY
+    ring->reserved.store(h + n, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < n; ++i) {
+        const auto& pos = path[first + i];
+        ring->slots[(h + i) % TrajectoryRing::CAPACITY].store(pack(pos.first, pos.second, episode),
+                                                              std::memory_order_relaxed);
+    }
+    ring->head.store(h + n, std::memory_order_release);
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    if (ring) munmap(const_cast<TrajectoryRing*>(ring), sizeof(TrajectoryRing));
+}
+
+bool TrajectoryReader::open(const std::string& name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size != static_cast<off_t>(sizeof(TrajectoryRing))) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, sizeof(TrajectoryRing), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    const auto* candidate = static_cast<const TrajectoryRing*>(mapped);
+    if (candidate->magic != TrajectoryRing::MAGIC || candidate->version != TrajectoryRing::VERSION) {
+        munmap(mapped, sizeof(TrajectoryRing));
+        return false;
+    }
+    ring = candidate;
+    cursor = 0;
+    lost = 0;
+    return true;
+}
+
+size_t TrajectoryReader::poll(std::vector<TrajectoryPoint>& out) {
+    if (!ring) return 0;
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    if (head < cursor) cursor = head;
+
+    uint64_t start = cursor;
+    if (head - start > TrajectoryRing::CAPACITY) {
+        lost += head - TrajectoryRing::CAPACITY - start;
+        start = head - TrajectoryRing::CAPACITY;
+    }
+
+    const size_t base = out.size();
+    for (uint64_t pos = start; pos < head; ++pos) {
+        out.push_back(unpack(ring->slots[pos % TrajectoryRing::CAPACITY].load(std::memory_order_relaxed)));
+    }
+
+    // points the writer started overwriting while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t reserved = ring->reserved.load(std::memory_order_relaxed);
+    const uint64_t oldestValid = reserved > TrajectoryRing::CAPACITY ? reserved - TrajectoryRing::CAPACITY : 0;
+    if (start < oldestValid) {
+        const uint64_t stale = std::min(oldestValid, head) - start;
+        out.erase(out.begin() + base, out.begin() + base + stale);
+        lost += stale;
+    }
+
+    cursor = head;
+    return out.size() - base;
+}
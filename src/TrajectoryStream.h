@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Car trajectories streamed from the trainer to the visualizer through a POSIX
+// shared-memory ring. The trainer publishes whole episodes and never waits for
+// a reader: when the visualizer falls behind, the oldest points are simply
+// overwritten and the reader skips ahead. The segment outlives the trainer, so
+// a visualizer started later still replays the most recent episodes.
+
+const char* const TRAJECTORY_STREAM_NAME = "/rl_car_trajectories";
+
+struct TrajectoryPoint {
+    int x;
+    int y;
+    uint32_t episode;
+};
+
+// layout of the shared segment
+struct TrajectoryRing {
+    static constexpr uint32_t MAGIC = 0x524c5452; // "RLTR"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t CAPACITY = 1 << 16; // points
+
+    uint32_t magic;
+    uint32_t version;
+    // end of the points being written, moved before the slots are touched
+    std::atomic<uint64_t> reserved;
+    // end of the published points, moved once the slots are written
+    std::atomic<uint64_t> head;
+    // x, y (16 bits each) and the episode number packed per slot
+    std::atomic<uint64_t> slots[CAPACITY];
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory ring needs lock-free 64-bit atomics");
+};
+
+class TrajectoryWriter {
+public:
+    TrajectoryWriter() = default;
+    ~TrajectoryWriter();
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+    // creates or reuses the segment, returns false if shared memory is unavailable
+    bool open(const std::string& name = TRAJECTORY_STREAM_NAME);
+    bool isOpen() const { return ring != nullptr; }
+
+    // appends one episode's path, a no-op when the stream is not open
+    void publish(uint32_t episode, const std::vector<std::pair<int, int>>& path);
+
+private:
+    TrajectoryRing* ring = nullptr;
+};
+
+class TrajectoryReader {
+public:
+    TrajectoryReader() = default;
+    ~TrajectoryReader();
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    // attaches to an existing segment, false until a trainer has created it
+    bool open(const std::string& name = TRAJECTORY_STREAM_NAME);
+    bool isOpen() const { return ring != nullptr; }
+
+    // appends the points published since the last call, returns how many.
+    // Points overwritten before they could be read are counted in dropped().
+    size_t poll(std::vector<TrajectoryPoint>& out);
+    uint64_t dropped() const { return lost; }
+
+private:
+    const TrajectoryRing* ring = nullptr;
+    uint64_t cursor = 0;
+    uint64_t lost = 0;
+};
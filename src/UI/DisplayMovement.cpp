@@ -5,6 +5,10 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <deque>
+#include <algorithm>
+#include "../TrajectoryStream.h"
+#include "../game/EpisodeLog.h"
 
 const int TILE_SIZE = 3; // Adjust to fix the display dimension
 
@@ -57,6 +61,48 @@ std::vector<std::pair<int, int>> loadMovement(const std::string& filePath) {
     return movement;
 }
 
+// draw the track grid
+void drawTrack(sf::RenderWindow& window, const std::vector<std::string>& track, int trackWidth, int trackHeight) {
+    sf::RectangleShape tile(sf::Vector2f(TILE_SIZE, TILE_SIZE));
+    for (int y = 0; y < trackHeight; ++y) {
+        for (int x = 0; x < trackWidth; ++x) {
+            char cellChar = track[y][x];
+
+            sf::Color tileColor;
+            switch (cellChar) {
+                case '#': tileColor = sf::Color(100, 100, 100); break; // Wall (Dark Grey)
+                case '.': tileColor = sf::Color(50, 50, 50); break;   // Path (Grey)
+                case 'S': tileColor = sf::Color::Green; break;      // Start (Green)
+                case 'G': tileColor = sf::Color::Blue; break;        // Goal (Blue)
+                default:  tileColor = sf::Color::Black; break;      // Empty (Black)
+            }
+
+            tile.setFillColor(tileColor);
+            tile.setPosition(sf::Vector2f(x * TILE_SIZE, y * TILE_SIZE));
+            window.draw(tile);
+        }
+    }
+}
+
+// path[0..index) as a trail and the car at path[index]
+void drawPath(sf::RenderWindow& window, const std::vector<std::pair<int, int>>& path, size_t index, bool useRed) {
+    if (path.empty()) return;
+
+    sf::CircleShape trail(TILE_SIZE / 3.0f);
+    trail.setFillColor(sf::Color(255, 255, 0, 120));
+    for (size_t i = 0; i < index; ++i) {
+        trail.setPosition(sf::Vector2f(path[i].first * TILE_SIZE + (TILE_SIZE - trail.getRadius() * 2) / 2.0f,
+                                       path[i].second * TILE_SIZE + (TILE_SIZE - trail.getRadius() * 2) / 2.0f));
+        window.draw(trail);
+    }
+
+    sf::CircleShape movementPoint(TILE_SIZE / 1.5f);
+    movementPoint.setFillColor(useRed ? sf::Color::Red : sf::Color(0, 255, 255));
+    movementPoint.setPosition(sf::Vector2f(path[index].first * TILE_SIZE + (TILE_SIZE - movementPoint.getRadius() * 2) / 2.0f,
+                                           path[index].second * TILE_SIZE + (TILE_SIZE - movementPoint.getRadius() * 2) / 2.0f));
+    window.draw(movementPoint);
+}
+
 // display the track and movement using SFML
 void displayTrackWithMovement(const std::string& trackFilePath, const std::string& movementFilePath) {
     int trackWidth = 0;
@@ -87,26 +133,7 @@ void displayTrackWithMovement(const std::string& trackFilePath, const std::strin
         window.clear(sf::Color::Black); // Background color
 
         // Draw the track grid
-        
-        sf::RectangleShape tile(sf::Vector2f(TILE_SIZE, TILE_SIZE));
-        for (int y = 0; y < trackHeight; ++y) {
-            for (int x = 0; x < trackWidth; ++x) {
-                char cellChar = track[y][x]; 
-
-                sf::Color tileColor;
-                switch (cellChar) {
-                    case '#': tileColor = sf::Color(100, 100, 100); break; // Wall (Dark Grey)
-                    case '.': tileColor = sf::Color(50, 50, 50); break;   // Path (Grey)
-                    case 'S': tileColor = sf::Color::Green; break;      // Start (Green)
-                    case 'G': tileColor = sf::Color::Blue; break;        // Goal (Blue)
-                    default:  tileColor = sf::Color::Black; break;      // Empty (Black)
-                }
-
-                tile.setFillColor(tileColor);
-                tile.setPosition(sf::Vector2f(x * TILE_SIZE, y * TILE_SIZE));
-                window.draw(tile);
-            }
-        }
+        drawTrack(window, track, trackWidth, trackHeight);
 
         // Draw the movement path (red / cyan to understand when all movements have been seen)
         sf::CircleShape movementPoint(TILE_SIZE / 1.5f); 
@@ -145,4 +172,150 @@ void displayTrackWithMovement(const std::string& trackFilePath, const std::strin
 
         window.display();
     }
-}
\ No newline at end of file
+}
+
+// tail the trainer's trajectory stream: every published episode is animated in
+// turn, the newest ones first when the trainer is faster than the animation
+void displayTrajectoryStream(const std::string& trackFilePath, const std::string& streamName) {
+    int trackWidth = 0;
+    int trackHeight = 0;
+    std::vector<std::string> track = loadTrack(trackFilePath, trackWidth, trackHeight);
+
+    if (track.empty() || trackWidth == 0 || trackHeight == 0) {
+        std::cerr << "Failed to load track. Exiting display.\n";
+        return;
+    }
+
+    sf::RenderWindow window(sf::VideoMode(sf::Vector2u( trackWidth * TILE_SIZE, trackHeight * TILE_SIZE)), "Waiting for the trainer...");
+    window.setFramerateLimit(60);
+
+    const size_t maxQueuedEpisodes = 4;
+    const int holdFrames = 30; // pause on the last position of a path
+
+    TrajectoryReader reader;
+    std::vector<TrajectoryPoint> incoming;
+    std::deque<std::pair<uint32_t, std::vector<std::pair<int, int>>>> queued;
+    std::vector<std::pair<int, int>> path;
+    uint32_t pathEpisode = 0;
+    size_t index = 0;
+    int frame = 0, hold = 0;
+    bool useRed = true;
+
+    while (window.isOpen()) {
+        while (const std::optional<sf::Event> event = window.pollEvent()) {
+            if (event->is<sf::Event::Closed>()) {
+                window.close();
+            }
+        }
+
+        // attach once the trainer has created the stream, retry every second
+        if (!reader.isOpen() && frame++ % 60 == 0 && reader.open(streamName)) {
+            std::cout << "Attached to trajectory stream " << streamName << std::endl;
+        }
+
+        // episodes are published whole, so the new points split into complete paths
+        incoming.clear();
+        reader.poll(incoming);
+        for (const TrajectoryPoint& p : incoming) {
+            if (queued.empty() || queued.back().first != p.episode) {
+                queued.emplace_back(p.episode, std::vector<std::pair<int, int>>());
+            }
+            queued.back().second.emplace_back(p.x, p.y);
+        }
+        while (queued.size() > maxQueuedEpisodes) queued.pop_front();
+
+        // next path once the current one has been shown
+        if (index + 1 >= path.size() && ++hold >= holdFrames) {
+            hold = 0;
+            if (!queued.empty()) {
+                pathEpisode = queued.front().first;
+                path = std::move(queued.front().second);
+                queued.pop_front();
+                window.setTitle("Episode " + std::to_string(pathEpisode));
+            } else {
+                useRed = !useRed; // replaying the same path
+            }
+            index = 0;
+        } else if (index + 1 < path.size()) {
+            ++index;
+        }
+
+        window.clear(sf::Color::Black);
+        drawTrack(window, track, trackWidth, trackHeight);
+
+        drawPath(window, path, index, useRed);
+
+        window.display();
+    }
+}
+
+// browse an episode log: Left/Right step through the episodes, PageUp/PageDown
+// jump by 100, Home/End go to the first/latest one
+void displayEpisodeLog(const std::string& trackFilePath, const std::string& logFilePath, long startEpisode) {
+    int trackWidth = 0;
+    int trackHeight = 0;
+    std::vector<std::string> track = loadTrack(trackFilePath, trackWidth, trackHeight);
+
+    Map map;
+    if (track.empty() || trackWidth == 0 || trackHeight == 0 || !map.loadFromFile(trackFilePath)) {
+        std::cerr << "Failed to load track. Exiting display.\n";
+        return;
+    }
+
+    EpisodeLogReader log;
+    if (!log.open(logFilePath) || log.size() == 0) {
+        std::cerr << "No episodes in " << logFilePath << "\n";
+        return;
+    }
+    std::cout << log.size() << " logged episodes." << std::endl;
+
+    sf::RenderWindow window(sf::VideoMode(sf::Vector2u( trackWidth * TILE_SIZE, trackHeight * TILE_SIZE)), "Episode log");
+    window.setFramerateLimit(60);
+
+    // negative indices count from the end, -1 is the latest episode
+    long current = startEpisode < 0 ? static_cast<long>(log.size()) + startEpisode : startEpisode;
+    long shown = -1;
+    Episode episode;
+    std::vector<std::pair<int, int>> path;
+    size_t index = 0;
+    bool useRed = true;
+
+    while (window.isOpen()) {
+        while (const std::optional<sf::Event> event = window.pollEvent()) {
+            if (event->is<sf::Event::Closed>()) {
+                window.close();
+            } else if (const auto* keyPressed = event->getIf<sf::Event::KeyPressed>()) {
+                if (keyPressed->code == sf::Keyboard::Key::Right) current += 1;
+                else if (keyPressed->code == sf::Keyboard::Key::Left) current -= 1;
+                else if (keyPressed->code == sf::Keyboard::Key::PageDown) current += 100;
+                else if (keyPressed->code == sf::Keyboard::Key::PageUp) current -= 100;
+                else if (keyPressed->code == sf::Keyboard::Key::Home) current = 0;
+                else if (keyPressed->code == sf::Keyboard::Key::End) current = static_cast<long>(log.size()) - 1;
+            }
+        }
+
+        // the log may still be growing, so its size is read again on every change
+        current = std::max(0L, std::min(current, static_cast<long>(log.size()) - 1));
+        if (current != shown && log.read(static_cast<size_t>(current), episode)) {
+            shown = current;
+            path = replayEpisode(map, episode);
+            index = 0;
+            window.setTitle("Episode " + std::to_string(episode.episode) + " (" + std::to_string(shown + 1) + "/"
+                            + std::to_string(log.size()) + "), " + std::to_string(episode.actions.size()) + " steps");
+        }
+
+        window.clear(sf::Color::Black);
+        drawTrack(window, track, trackWidth, trackHeight);
+
+        if (!path.empty()) {
+            drawPath(window, path, index, useRed);
+
+            if (++index >= path.size()) {
+                index = 0;
+                useRed = !useRed; // toggle color when the path restarts
+            }
+        }
+
+        window.display();
+    }
+}
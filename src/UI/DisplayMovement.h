@@ -4,4 +4,8 @@
 
 
 void displayTrackWithMovement(const std::string& trackFilePath, const std::string& movementFilePath);
+// animates the episodes published by a running trainer, never blocks it
+void displayTrajectoryStream(const std::string& trackFilePath, const std::string& streamName);
+// replays episodes of a binary episode log, startEpisode < 0 counts from the latest
+void displayEpisodeLog(const std::string& trackFilePath, const std::string& logFilePath, long startEpisode = -1);
 
@@ -0,0 +1,388 @@
+// Microbenchmarks of the training hot paths, reported as JSON on stdout.
+//
+//   ./bench [--filter text] [--reps n] [--min-time ms] [--cpu n] [--map path] [--out file]
+//
+// Every case is first run until one batch of calls takes --min-time (this is
+// the warm-up and fixes the batch size), then timed over --reps batches. The
+// per-call times of the batches give the mean, median, spread and coefficient
+// of variation; compare medians between builds. --cpu pins the process to one
+// core before any worker thread starts (Linux only, elsewhere it is reported
+// as not pinned), so the thread pool then runs on that core alone. RL_THREADS
+// and RL_KERNELS apply as in training; "threads" reports the pool size used.
+
+#include "Kernels.h"
+#include "Layer.h"
+#include "NeuralNetwork.h"
+#include "ReplayBuffer.h"
+#include "State.h"
+#include "StaticNetwork.h"
+#include "ThreadPool.h"
+#include "game/Car.h"
+#include "game/Map.h"
+#include "game/VecEnv.h"
+#include "Log.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+struct Options {
+    std::string filter;
+    int reps = 10;
+    double minTimeMs = 20.0;
+    int cpu = -1;
+    std::string mapPath = "./assets/track.txt";
+    std::string outPath;
+};
+
+struct Result {
+    std::string name;
+    double itemsPerCall = 1.0;  // samples, rays, ... handled by one call
+    size_t callsPerRep = 0;
+    std::vector<double> ns;     // per call, one entry per repetition
+};
+
+// keeps the compiler from dropping a result nobody reads
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename F>
+double timeCalls(F& call, size_t calls) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < calls; ++i) call();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+class Suite {
+public:
+    explicit Suite(const Options& options) : options(options) {}
+
+    template <typename F>
+    void run(const std::string& name, double itemsPerCall, F call) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+
+        // warm-up: grow the batch until it takes the minimum time
+        const double target = options.minTimeMs * 1e6;
+        size_t calls = 1;
+        for (double elapsed = timeCalls(call, calls); elapsed < target; elapsed = timeCalls(call, calls)) {
+            const double scale = elapsed > 0.0 ? 1.2 * target / elapsed : 10.0;
+            calls = static_cast<size_t>(calls * std::min(10.0, std::max(1.5, scale)));
+        }
+
+        Result result;
+        result.name = name;
+        result.itemsPerCall = itemsPerCall;
+        result.callsPerRep = calls;
+        for (int r = 0; r < options.reps; ++r) {
+            result.ns.push_back(timeCalls(call, calls) / calls);
+        }
+        LOG_INFO(name << ": " << median(result.ns) << " ns/op");
+        results.push_back(std::move(result));
+    }
+
+    void writeJson(std::ostream& out, bool pinned) const {
+        out << "{\n  \"context\": {"
+            << "\"kernels\": \"" << kernels<net_scalar>().name << "\", "
+            << "\"scalar_bytes\": " << sizeof(net_scalar) << ", "
+            << "\"moment_bytes\": " << sizeof(moment_scalar) << ", "
+            << "\"threads\": " << ThreadPool::shared().size() << ", "
+            << "\"hardware_threads\": " << std::thread::hardware_concurrency() << ", "
+            << "\"cpu\": " << (pinned ? options.cpu : -1) << ", "
+            << "\"pinned\": " << (pinned ? "true" : "false") << ", "
+            << "\"repetitions\": " << options.reps << ", "
+            << "\"min_time_ms\": " << options.minTimeMs << "},\n"
+            << "  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            const double mean = average(r.ns);
+            double variance = 0.0;
+            for (double v : r.ns) variance += (v - mean) * (v - mean);
+            variance /= std::max<size_t>(1, r.ns.size() - 1);
+            const double med = median(r.ns);
+
+            out << (i ? "," : "") << "\n    {"
+                << "\"name\": \"" << r.name << "\", "
+                << "\"calls_per_rep\": " << r.callsPerRep << ", "
+                << "\"ns_per_op_median\": " << med << ", "
+                << "\"ns_per_op_mean\": " << mean << ", "
+                << "\"ns_per_op_min\": " << *std::min_element(r.ns.begin(), r.ns.end()) << ", "
+                << "\"ns_per_op_max\": " << *std::max_element(r.ns.begin(), r.ns.end()) << ", "
+                << "\"ns_per_op_stddev\": " << std::sqrt(variance) << ", "
+                << "\"cv\": " << (mean > 0.0 ? std::sqrt(variance) / mean : 0.0) << ", "
+                << "\"ops_per_sec\": " << 1e9 / med << ", "
+                << "\"items_per_op\": " << r.itemsPerCall << ", "
+                << "\"items_per_sec\": " << r.itemsPerCall * 1e9 / med << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    static double average(const std::vector<double>& v) {
+        double sum = 0.0;
+        for (double x : v) sum += x;
+        return v.empty() ? 0.0 : sum / v.size();
+    }
+
+    static double median(std::vector<double> v) {
+        if (v.empty()) return 0.0;
+        std::sort(v.begin(), v.end());
+        const size_t mid = v.size() / 2;
+        return v.size() % 2 ? v[mid] : 0.5 * (v[mid - 1] + v[mid]);
+    }
+
+    const Options& options;
+    std::vector<Result> results;
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value for " << arg);
+            return false;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--filter") options.filter = value;
+        else if (arg == "--reps") options.reps = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--min-time") options.minTimeMs = std::max(0.1, std::atof(value.c_str()));
+        else if (arg == "--cpu") options.cpu = std::atoi(value.c_str());
+        else if (arg == "--map") options.mapPath = value;
+        else if (arg == "--out") options.outPath = value;
+        else {
+            LOG_ERROR("Unknown option " << arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+// pins this thread, and every thread it starts afterwards, to `cpu`
+bool pinToCpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == 0) return true;
+    LOG_WARN("Could not pin to CPU " << cpu);
+#else
+    LOG_WARN("CPU pinning is not supported on this platform, running unpinned");
+    (void)cpu;
+#endif
+    return false;
+}
+
+// ProductionNetwork against NeuralNetwork::forward on `count` encoded states, with the
+// weights copied from `network` and read back from a checkpoint of it
+bool staticNetworkMatches(const NeuralNetwork& network, const net_scalar* states, int count) {
+    const double tolerance = sizeof(net_scalar) == sizeof(float) ? 1e-4 : 1e-9;
+    auto agrees = [&](const ProductionNetwork& fast, const char* source) {
+        std::array<net_scalar, ProductionNetwork::outputSize()> out;
+        for (int b = 0; b < count; ++b) {
+            const net_scalar* state = states + static_cast<size_t>(b) * ProductionNetwork::inputSize();
+            fast.forward(state, out.data());
+            const net_scalar* expected = network.forward(state, 1, NeuralNetwork::threadWorkspace());
+            for (int j = 0; j < ProductionNetwork::outputSize(); ++j) {
+                if (std::abs(out[j] - expected[j]) > tolerance * (1.0 + std::abs(expected[j]))) {
+                    LOG_ERROR("Static network (" << source << ") gives " << out[j] << " instead of "
+                              << expected[j] << " for state " << b << ", Q-value " << j);
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    auto copied = std::make_unique<ProductionNetwork>();
+    if (!copied->copyFrom(network) || !agrees(*copied, "copyFrom")) return false;
+
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_static_network.rlck").string();
+    auto loaded = std::make_unique<ProductionNetwork>();
+    const bool ok = network.saveCheckpoint(path) && loaded->loadCheckpoint(path) && agrees(*loaded, "loadCheckpoint");
+    std::filesystem::remove(path);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 1;
+    // progress is only logged when the results go to a file, stdout stays valid JSON
+    if (options.outPath.empty()) logging::setLevel(LogLevel::Warn);
+
+    const bool pinned = options.cpu >= 0 && pinToCpu(options.cpu);
+    if (pinned && ThreadPool::shared().size() > 1) {
+        LOG_WARN("RL_THREADS=" << ThreadPool::shared().size() << " threads share CPU " << options.cpu);
+    }
+    if (!kernelSelfTest()) {
+        LOG_ERROR("Vector kernels disagree with the scalar reference, aborting.");
+        return 1;
+    }
+
+    Map map;
+    if (!map.loadFromFile(options.mapPath)) {
+        LOG_ERROR("Could not load " << options.mapPath);
+        return 1;
+    }
+    FeatureTable table;
+    buildFeatureTable(table, map);
+
+    // shuffled free cells, visited in turn so lookups do not stay in one cache line
+    std::mt19937 rng(1234);
+    std::vector<std::pair<int, int>> cells;
+    for (int y = 0; y < map.getHeight(); ++y) {
+        for (int x = 0; x < map.getWidth(); ++x) {
+            if (map.getTile(x, y) != '#') cells.emplace_back(x, y);
+        }
+    }
+    if (cells.empty()) {
+        LOG_ERROR(options.mapPath << " has no free cells");
+        return 1;
+    }
+    std::shuffle(cells.begin(), cells.end(), rng);
+    size_t nextCell = 0;
+    auto cell = [&]() -> const std::pair<int, int>& {
+        nextCell = nextCell + 1 == cells.size() ? 0 : nextCell + 1;
+        return cells[nextCell];
+    };
+
+    Suite suite(options);
+    const int hidden = 128;
+    const std::vector<int> layerSizes = {State::NUM_FEATURES, hidden, hidden, 6};
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+    // one hidden layer of the trainer's network
+    using Layer = LayerT<net_scalar, moment_scalar>;
+    ParameterArena<net_scalar, moment_scalar> arena;
+    arena.allocate(Layer::arenaSize(hidden, hidden));
+    Layer layer(hidden, hidden, 1, false, arena, 0);
+    AlignedVector<net_scalar> layerIn(64 * hidden), layerOut(64 * hidden);
+    for (auto& v : layerIn) v = static_cast<net_scalar>(unit(rng));
+    for (int batch : {1, 64}) {
+        suite.run("layer_forward_b" + std::to_string(batch), batch, [&] {
+            layer.forwardInto(layerIn.data(), batch, layerOut.data());
+            keep(layerOut[0]);
+        });
+    }
+
+    // gradients are consumed by every step, the pass over weights and moments is the same
+    suite.run("adam_optimize_128x128", static_cast<double>(hidden) * hidden + hidden, [&] {
+        layer.optimizer.optimize(layer.weights, layer.biases, layer.grad_weights, layer.grad_biases);
+        keep(layer.weights[0]);
+    });
+
+    NeuralNetwork network(layerSizes, 0.0, 0.001, "no_load");
+
+    // single states and actor-sized batches through the dynamic and the compile-time network
+    AlignedVector<net_scalar> encoded(64 * State::NUM_FEATURES);
+    for (size_t b = 0; b < 64; ++b) {
+        const auto& c = cell();
+        table.encode(observe(map, c.first, c.second, static_cast<Direction>(b % 4), 1 + b % 5),
+                     &encoded[b * State::NUM_FEATURES]);
+    }
+    if (!staticNetworkMatches(network, encoded.data(), 64)) {
+        LOG_ERROR("ProductionNetwork disagrees with NeuralNetwork, aborting.");
+        return 1;
+    }
+    auto staticNetwork = std::make_unique<ProductionNetwork>();
+    staticNetwork->copyFrom(network);
+    std::vector<net_scalar> qValues(64 * ProductionNetwork::outputSize());
+    for (int batch : {1, 8}) {
+        suite.run("network_forward_b" + std::to_string(batch), batch, [&] {
+            keep(*network.forward(encoded.data(), batch, NeuralNetwork::threadWorkspace()));
+        });
+        suite.run("static_network_forward_b" + std::to_string(batch), batch, [&] {
+            staticNetwork->forwardBatch(encoded.data(), batch, qValues.data());
+            keep(qValues[0]);
+        });
+    }
+    for (int batch : {32, 64, 256}) {
+        AlignedVector<net_scalar> states(static_cast<size_t>(batch) * State::NUM_FEATURES);
+        std::vector<int> actions(batch);
+        std::vector<double> targets(batch);
+        for (int b = 0; b < batch; ++b) {
+            const auto& c = cell();
+            table.encode(observe(map, c.first, c.second, static_cast<Direction>(b % 4), 1 + b % 5),
+                         &states[static_cast<size_t>(b) * State::NUM_FEATURES]);
+            actions[b] = b % 6;
+            targets[b] = 0.1 * unit(rng);
+        }
+        suite.run("network_learn_b" + std::to_string(batch), batch, [&] {
+            network.learn(states.data(), actions.data(), targets.data(), batch);
+        });
+    }
+
+    std::vector<Car> cars;
+    for (size_t i = 0; i < std::min<size_t>(cells.size(), 4096); ++i) cars.emplace_back(cells[i].first, cells[i].second);
+    size_t nextCar = 0;
+    suite.run("car_min_dots_to_goal", 1, [&] {
+        nextCar = nextCar + 1 == cars.size() ? 0 : nextCar + 1;
+        keep(cars[nextCar].minDotsToGoal(map));
+    });
+
+    // the grid scans behind the wall distance table, one ray per direction
+    suite.run("wall_rays", 4, [&] {
+        const auto& c = cell();
+        for (Direction dir : {UP, RIGHT, DOWN, LEFT}) keep(map.freeRun(c.first, c.second, dir));
+    });
+
+    std::array<net_scalar, State::NUM_FEATURES> features;
+    suite.run("state_write_features", 1, [&] {
+        const auto& c = cell();
+        observe(map, c.first, c.second, RIGHT, 3).writeFeatures(features.data());
+        keep(features[0]);
+    });
+    suite.run("state_encode_table", 1, [&] {
+        const auto& c = cell();
+        table.encode(observe(map, c.first, c.second, RIGHT, 3), features.data());
+        keep(features[0]);
+    });
+
+    // a full buffer of transitions between random cells
+    const size_t capacity = 100000;
+    for (double alpha : {0.0, 0.6}) {
+        ReplayBuffer replay(capacity);
+        replay.setPriorityExponent(alpha);
+        for (size_t i = 0; i < capacity; ++i) {
+            const auto& from = cell();
+            const auto& to = cell();
+            replay.add(packState(from.first, from.second, UP, 1), static_cast<int>(i % 6), unit(rng),
+                       packState(to.first, to.second, RIGHT, 2), i % 50 == 0);
+        }
+        ReplayBatch batch;
+        suite.run(alpha > 0.0 ? "replay_sample_prioritized_b64" : "replay_sample_b64", 64, [&] {
+            replay.sample(64, table, batch, 0.4);
+            keep(batch.states[0]);
+        });
+    }
+
+    if (options.outPath.empty()) {
+        suite.writeJson(std::cout, pinned);
+    } else {
+        std::ofstream out(options.outPath);
+        if (!out) {
+            LOG_ERROR("Could not open " << options.outPath);
+            return 1;
+        }
+        suite.writeJson(out, pinned);
+        LOG_INFO("Results written to " << options.outPath);
+    }
+    logging::flush();
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "NeuralNetwork.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Converts a text checkpoint directory (layerN.txt + layerN_adam_state.txt,
+// e.g. trained_agent/episode_10000/q_network) into a binary .rlck file.
+//
+//   convert_checkpoint <text_dir> <out.rlck> [layer sizes, default 9,128,128,6]
+int main(int argc, char** argv) {
+    const std::string usage = std::string("usage: ") + argv[0] + " <text_dir> <out.rlck> [9,128,128,6]";
+    if (argc < 3) {
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+
+    std::vector<int> layerSizes = {9, 128, 128, 6};
+    if (argc > 3) {
+        layerSizes.clear();
+        std::stringstream sizes(argv[3]);
+        std::string size;
+        try {
+            while (std::getline(sizes, size, ',')) {
+                layerSizes.push_back(std::stoi(size));
+            }
+        } catch (const std::logic_error&) {
+            std::cerr << "Error: bad layer size \"" << size << "\"\n" << usage << std::endl;
+            return 1;
+        }
+        if (layerSizes.size() < 2 || *std::min_element(layerSizes.begin(), layerSizes.end()) < 1) {
+            std::cerr << "Error: need at least an input and an output size, all positive" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!std::filesystem::is_directory(argv[1])) {
+        std::cerr << "Error: " << argv[1] << " is not a directory" << std::endl;
+        return 1;
+    }
+
+    // the constructor would prefer a .rlck next to the directory and falls back to
+    // random weights, so the text files are read again and must all be complete
+    NeuralNetwork network(layerSizes, 0.0, 0.001, argv[1]);
+    if (!network.load(argv[1])) {
+        std::cerr << "Error: " << argv[1] << " does not hold every layer and Adam state of a "
+                  << (layerSizes.size() - 1) << "-layer network, nothing written" << std::endl;
+        return 1;
+    }
+    return network.saveCheckpoint(argv[2]) ? 0 : 1;
+}
@@ -1,10 +1,49 @@
 #include "Car.h"
 #include "../Utils.h"
+#include "../Log.h"
 
-Car::Car(int startX, int startY) : x(startX), y(startY), velocity(1), dir(UP) {}
+namespace {
+int faster(int velocity) { return std::min(velocity + 1, 5); } // speed range 1 - 5
+int slower(int velocity) { return std::max(velocity - 1, 1); }
+}
+
+void applyCarAction(int action, Direction& dir, int& velocity) {
+    switch (action) {
+        case 0: velocity = faster(velocity); break;
+        case 1: velocity = slower(velocity); break;
+        case 2: if (dir == RIGHT) velocity = slower(velocity); else dir = LEFT; break;
+        case 3: if (dir == LEFT) velocity = slower(velocity); else dir = RIGHT; break;
+        case 4: if (dir == DOWN) velocity = slower(velocity); else dir = UP; break;
+        case 5: if (dir == UP) velocity = slower(velocity); else dir = DOWN; break;
+        default: LOG_ERROR("Unknown action: " << action); break;
+    }
+}
+
+UpdateStatus moveCar(const Map& map, int& x, int& y, Direction dir, int& velocity) {
+    int nx = x, ny = y;
+    switch (dir) {
+        case UP: ny -= velocity; break;
+        case RIGHT: nx += velocity; break;
+        case DOWN: ny += velocity; break;
+        case LEFT: nx -= velocity; break;
+    }
+    // the car moves at most 5 tiles, well inside the map's wall border
+    if (map.isWall(nx, ny)) {
+        LOG_DEBUG("collision detected");
+        velocity = 0;
+        return UpdateStatus::COLLISION;
+    }
+
+    x = nx;
+    y = ny;
+    return map.tileAt(nx, ny) == 'G' ? UpdateStatus::GOAL : UpdateStatus::OK;
+}
+
+Car::Car(int startX, int startY, Direction startDir, int startVelocity)
+    : x(startX), y(startY), velocity(startVelocity), dir(startDir) {}
 
 void Car::accelerate() {
-    velocity = std::min(velocity + 1, 5); // speed range 1 - 5
+    velocity = faster(velocity);
 }
 
 void Car::turnLeft() {
@@ -15,14 +54,6 @@ void Car::turnRight() {
     dir = static_cast<Direction>((dir + 1) % 4);
 }
 
-bool Car::checkCollision(const Map& map, int nextX, int nextY) {
-    char tile = map.getTile(nextX, nextY);
-    if (tile == '#') {
-        return true; 
-    }
-    return false;
-}
-
 int Car::getVelocity() {
     return this->velocity;
 }
@@ -32,28 +63,7 @@ Direction Car::getDirection() {
 }
 
 UpdateStatus Car::update(const Map& map) {
-    int nx = x, ny = y;
-    switch (dir) {
-        case UP: ny -= velocity; break;
-        case RIGHT: nx += velocity; break;
-        case DOWN: ny += velocity; break;
-        case LEFT: nx -= velocity; break;
-    }
-    if (checkCollision(map, nx, ny)) {
-        std::cout<<"collision detected\n";
-        velocity = 0;
-        return UpdateStatus::COLLISION;
-    }
-
-    if (map.getTile(nx, ny) == 'G') {
-        x = nx;
-        y = ny;
-        return UpdateStatus::GOAL;
-    }
-
-    x = nx;
-    y = ny;
-    return UpdateStatus::OK;
+    return moveCar(map, x, y, dir, velocity);
 }
 
 int Car::getX() const { return x; }
@@ -63,47 +73,15 @@ void Car::setDirection(Direction newDir) {
     dir = newDir;
 }
 
-void Car::decelerate() {
-    velocity = std::max(velocity - 1, 1);
+void Car::applyAction(int action) {
+    applyCarAction(action, dir, velocity);
 }
 
-// BFS to find distance car - goal
-int Car::minDotsToGoal(const Map& map) {
-    const int rows = MAP_HEIGHT, cols = MAP_WIDTH;
-    int gX = -1, gY = -1;
-
-    map.find('G', gX, gY);
-    std::pair<int, int> goal = {gY, gX}; 
-    std::queue<std::tuple<int, int, int>> q;  
-    std::vector<std::vector<bool>> visited(rows, std::vector<bool>(cols, false));
-    q.push({y, x, 0});
-    visited[y][x] = true;
-
-    int dr[] = {-1, 1, 0, 0};  // N, S
-    int dc[] = {0, 0, -1, 1};  // W, E
-
-    while (!q.empty()) {
-        auto [r, c, dots] = q.front(); q.pop();
-
-        if (r == goal.first && c == goal.second){
-            return dots;
-        }
-
-        for (int d = 0; d < 4; ++d) {
-            int nr = r + dr[d];
-            int nc = c + dc[d];
-
-            if (nr >= 0 && nr < rows && nc >= 0 && nc < cols && !visited[nr][nc]) {
-                char tile = map.getTile(nc, nr); 
-                if (tile == '.' || tile == 'G') {
-                    visited[nr][nc] = true;
-                    int newDots = dots + (tile == '.' ? 1 : 0);
-                    q.push({nr, nc, newDots});
-                }
-            }
-        }
-    }
-
-    return -1;
+void Car::decelerate() {
+    velocity = slower(velocity);
 }
 
+// distance car - goal, precomputed by the map
+int Car::minDotsToGoal(const Map& map) const {
+    return map.goalDistance(x, y);
+}
@@ -4,9 +4,17 @@
 #include<iostream>
 #include <fstream>
 
+// The car rules on plain values, so Car and the car arrays of VecEnv move alike.
+// applyCarAction: one of the agent's 6 actions, accelerate, brake, or steer
+// left/right/up/down, where steering into the opposite heading brakes instead.
+void applyCarAction(int action, Direction& dir, int& velocity);
+// moveCar: `velocity` tiles towards `dir`, only the destination tile is tested.
+// A crash leaves the car in place with velocity 0.
+UpdateStatus moveCar(const Map& map, int& x, int& y, Direction dir, int& velocity);
+
 class Car {
 public:
-    Car(int startX, int startY);
+    Car(int startX, int startY, Direction startDir = UP, int startVelocity = 1);
     
     UpdateStatus update(const Map& map); 
 
@@ -16,11 +24,13 @@ public:
     void turnRight();
     void reset();
     void setDirection(Direction newDir);
+    // one of the agent's 6 actions, see applyCarAction()
+    void applyAction(int action);
 
     int getX() const;
     int getY() const;
     char getDirectionChar() const;
-    int minDotsToGoal(const Map& map);
+    int minDotsToGoal(const Map& map) const;
 
     int getVelocity();
     Direction getDirection();
@@ -29,6 +39,4 @@ private:
     int x, y;
     int velocity;
     Direction dir;
-
-    bool checkCollision(const Map& map, int nextX, int nextY);
 };
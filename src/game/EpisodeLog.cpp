@@ -0,0 +1,166 @@
+#include "EpisodeLog.h"
+#include "Car.h"
+#include "../Log.h"
+#include <cstring>
+#include <sys/stat.h>
+
+namespace {
+
+uint64_t fileSize(std::FILE* file) {
+    struct stat st;
+    return fstat(fileno(file), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+} // namespace
+
+std::vector<std::pair<int, int>> replayEpisode(const Map& map, const Episode& ep) {
+    std::vector<std::pair<int, int>> path;
+    path.reserve(ep.actions.size() + 1);
+    Car car(ep.startX, ep.startY, ep.startDir, ep.startVelocity);
+    path.emplace_back(car.getX(), car.getY());
+    for (uint8_t action : ep.actions) {
+        car.applyAction(action);
+        car.update(map);
+        path.emplace_back(car.getX(), car.getY());
+    }
+    return path;
+}
+
+EpisodeLogWriter::~EpisodeLogWriter() { close(); }
+
+void EpisodeLogWriter::close() {
+    if (data) std::fclose(data);
+    if (index) std::fclose(index);
+    data = index = nullptr;
+}
+
+bool EpisodeLogWriter::open(const std::string& file_path) {
+    close();
+    data = std::fopen(file_path.c_str(), "a+b");
+    if (!data) {
+        LOG_ERROR("Could not open episode log " << file_path);
+        return false;
+    }
+
+    position = fileSize(data);
+    if (position == 0) {
+        EpisodeLogHeader header{};
+        std::memcpy(header.magic, EPISODE_LOG_MAGIC, sizeof(header.magic));
+        header.version = EPISODE_LOG_VERSION;
+        if (std::fwrite(&header, sizeof(header), 1, data) != 1) {
+            LOG_ERROR("Could not write episode log header to " << file_path);
+            close();
+            return false;
+        }
+        position = sizeof(header);
+    } else {
+        EpisodeLogHeader header{};
+        std::fseek(data, 0, SEEK_SET);
+        if (std::fread(&header, sizeof(header), 1, data) != 1
+            || std::memcmp(header.magic, EPISODE_LOG_MAGIC, sizeof(header.magic)) != 0
+            || header.version != EPISODE_LOG_VERSION) {
+            LOG_ERROR(file_path << " is not an episode log (version " << EPISODE_LOG_VERSION << ")");
+            close();
+            return false;
+        }
+    }
+
+    // a new log starts a new index
+    index = std::fopen((file_path + ".idx").c_str(), position == sizeof(EpisodeLogHeader) ? "wb" : "ab");
+    if (!index) {
+        LOG_ERROR("Could not open episode index " << file_path << ".idx");
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool EpisodeLogWriter::append(const Episode& ep) {
+    if (!data) return false;
+
+    EpisodeLogRecord record{};
+    record.episode = ep.episode;
+    record.start_x = static_cast<int16_t>(ep.startX);
+    record.start_y = static_cast<int16_t>(ep.startY);
+    record.start_dir = static_cast<uint8_t>(ep.startDir);
+    record.start_velocity = static_cast<uint8_t>(ep.startVelocity);
+    record.steps = static_cast<uint32_t>(ep.actions.size());
+
+    if (std::fwrite(&record, sizeof(record), 1, data) != 1
+        || std::fwrite(ep.actions.data(), 1, ep.actions.size(), data) != ep.actions.size()
+        || std::fflush(data) != 0) {
+        LOG_ERROR("Could not write episode " << ep.episode << " to the episode log");
+        return false;
+    }
+
+    // the record is on disk before the index points at it
+    const uint64_t offset = position;
+    if (std::fwrite(&offset, sizeof(offset), 1, index) != 1 || std::fflush(index) != 0) {
+        LOG_ERROR("Could not index episode " << ep.episode);
+        return false;
+    }
+    position += sizeof(record) + ep.actions.size();
+    return true;
+}
+
+EpisodeLogReader::~EpisodeLogReader() { close(); }
+
+void EpisodeLogReader::close() {
+    if (data) std::fclose(data);
+    if (index) std::fclose(index);
+    data = index = nullptr;
+}
+
+bool EpisodeLogReader::open(const std::string& file_path) {
+    close();
+    data = std::fopen(file_path.c_str(), "rb");
+    if (!data) {
+        LOG_ERROR("Could not open episode log " << file_path);
+        return false;
+    }
+
+    EpisodeLogHeader header{};
+    if (std::fread(&header, sizeof(header), 1, data) != 1
+        || std::memcmp(header.magic, EPISODE_LOG_MAGIC, sizeof(header.magic)) != 0
+        || header.version != EPISODE_LOG_VERSION) {
+        LOG_ERROR(file_path << " is not an episode log (version " << EPISODE_LOG_VERSION << ")");
+        close();
+        return false;
+    }
+
+    index = std::fopen((file_path + ".idx").c_str(), "rb");
+    if (!index) {
+        LOG_ERROR("Could not open episode index " << file_path << ".idx");
+        close();
+        return false;
+    }
+    return true;
+}
+
+size_t EpisodeLogReader::size() const {
+    return index ? fileSize(index) / sizeof(uint64_t) : 0;
+}
+
+bool EpisodeLogReader::read(size_t i, Episode& ep) const {
+    if (i >= size()) return false;
+
+    uint64_t offset = 0;
+    EpisodeLogRecord record{};
+    if (std::fseek(index, static_cast<long>(i * sizeof(offset)), SEEK_SET) != 0
+        || std::fread(&offset, sizeof(offset), 1, index) != 1
+        || std::fseek(data, static_cast<long>(offset), SEEK_SET) != 0
+        || std::fread(&record, sizeof(record), 1, data) != 1
+        || offset + sizeof(record) + record.steps > fileSize(data)
+        || record.start_dir > LEFT) {
+        LOG_ERROR("Episode " << i << " of the episode log is damaged");
+        return false;
+    }
+
+    ep.episode = record.episode;
+    ep.startX = record.start_x;
+    ep.startY = record.start_y;
+    ep.startDir = static_cast<Direction>(record.start_dir);
+    ep.startVelocity = record.start_velocity;
+    ep.actions.resize(record.steps);
+    return std::fread(ep.actions.data(), 1, record.steps, data) == record.steps;
+}
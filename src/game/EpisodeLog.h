@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Map.h"
+#include "../Utils.h"
+
+// Binary episode log (.rlep), one byte per step.
+//
+//   EpisodeLogHeader                        16 bytes
+//   per episode: EpisodeLogRecord           16 bytes
+//                actions[steps]             one byte per Car::applyAction call
+//
+// The car's motion is deterministic, so the start state and the actions are
+// enough to rebuild every position with replayEpisode(). A companion index
+// file (<path>.idx) holds the uint64 byte offset of every record, which makes
+// seeking to the n-th episode O(1). Both files are only ever appended to.
+
+static const char EPISODE_LOG_MAGIC[4] = {'R', 'L', 'E', 'P'};
+static const uint32_t EPISODE_LOG_VERSION = 1;
+
+struct EpisodeLogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t reserved[2];
+};
+static_assert(sizeof(EpisodeLogHeader) == 16, "episode log header must stay 16 bytes");
+
+struct EpisodeLogRecord {
+    uint32_t episode;
+    int16_t start_x;
+    int16_t start_y;
+    uint8_t start_dir;
+    uint8_t start_velocity;
+    uint16_t reserved;
+    uint32_t steps;
+};
+static_assert(sizeof(EpisodeLogRecord) == 16, "episode record must stay 16 bytes");
+
+struct Episode {
+    uint32_t episode = 0;
+    int startX = 0, startY = 0;
+    Direction startDir = UP;
+    int startVelocity = 1;
+    std::vector<uint8_t> actions;
+};
+
+// positions of the car from the start through every step of `ep`
+std::vector<std::pair<int, int>> replayEpisode(const Map& map, const Episode& ep);
+
+class EpisodeLogWriter {
+public:
+    EpisodeLogWriter() = default;
+    ~EpisodeLogWriter();
+    EpisodeLogWriter(const EpisodeLogWriter&) = delete;
+    EpisodeLogWriter& operator=(const EpisodeLogWriter&) = delete;
+
+    // opens the log for appending, creating it if needed
+    bool open(const std::string& file_path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    bool append(const Episode& ep);
+
+private:
+    std::FILE* data = nullptr;
+    std::FILE* index = nullptr;
+    uint64_t position = 0;
+};
+
+class EpisodeLogReader {
+public:
+    EpisodeLogReader() = default;
+    ~EpisodeLogReader();
+    EpisodeLogReader(const EpisodeLogReader&) = delete;
+    EpisodeLogReader& operator=(const EpisodeLogReader&) = delete;
+
+    // validates the header, prints the reason and returns false on failure
+    bool open(const std::string& file_path);
+    void close();
+
+    // episodes in the log, re-read from the index so a log still being written keeps growing
+    size_t size() const;
+    // reads the i-th logged episode (0 = oldest)
+    bool read(size_t i, Episode& ep) const;
+
+private:
+    std::FILE* data = nullptr;
+    std::FILE* index = nullptr;
+};
@@ -1,29 +1,30 @@
 #include "Game.h"
+#include "../Log.h"
 #include <iostream>
 #include <chrono>
 #include <thread>
 
 
 Game::Game() : car(-1, -1), gameOver(false) {
-    std::cout << "Loading track...\n";
+    LOG_INFO("Loading track...");
     if (!track.loadFromFile("./assets/track.txt")) {
-        std::cerr << "Failed to load track.\n";
+        LOG_ERROR("Failed to load track.");
         return;
     }
-    std::cout << "Track loaded successfully.\n";
+    LOG_INFO("Track loaded successfully.");
 
     int startX = -99, startY = -99;
     if (track.find('S', startX, startY)) {
-        std::cout << "Found start at: (" << startX << ", " << startY << ")\n";
+        LOG_INFO("Found start at: (" << startX << ", " << startY << ")");
         car = Car(startX, startY);
     } else {
-        std::cerr << "Start position 'S' not found on map.\n";
+        LOG_ERROR("Start position 'S' not found on map.");
     }
     movementFile.open("./assets/movements.txt");
     if (!movementFile.is_open()) {
-        std::cerr << "Failed to open movement file: " << "./assets/movements.txt" << std::endl;
+        LOG_ERROR("Failed to open movement file: " << "./assets/movements.txt");
     } else {
-        std::cout << "Movement file opened successfully: " << "./assets/movements.txt" << std::endl;
+        LOG_INFO("Movement file opened successfully: " << "./assets/movements.txt");
     }
 }
 
@@ -72,7 +73,7 @@ void Game::run() {
 
     if (movementFile.is_open()) {
         movementFile.close();
-        std::cout << "Movement file closed.\n";
+        LOG_INFO("Movement file closed.");
     }
 
     std::cout << "Game over. Displaying track and movement...\n";
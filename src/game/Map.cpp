@@ -1,6 +1,10 @@
 #include "Map.h"
+#include "../Profiler.h"
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <queue>
 
 Map::Map() {}
 
@@ -8,32 +12,58 @@ bool Map::loadFromFile(const std::string& filename) {
     std::ifstream inFile(filename);
     if (!inFile) return false;
 
-    grid.clear();
+    std::vector<std::string> lines;
     std::string line;
     while (std::getline(inFile, line)) {
-        grid.push_back(line);
+        lines.push_back(line);
     }
 
+    height = static_cast<int>(lines.size());
+    width = 0;
+    for (const auto& row : lines) width = std::max(width, static_cast<int>(row.size()));
+    stride = width + 2 * BORDER;
+    rowWords = (stride + 63) / 64;
+
+    // short rows and the border read as walls, as getTile always did outside the grid
+    cells.assign(static_cast<size_t>(height + 2 * BORDER) * stride, '#');
+    wallBits.assign(static_cast<size_t>(height + 2 * BORDER) * rowWords, ~uint64_t(0));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < static_cast<int>(lines[y].size()); ++x) {
+            cells[index(x, y)] = lines[y][x];
+            setWallBit(index(x, y), lines[y][x] == '#');
+        }
+    }
+
+    buildTables();
     return true;
 }
 
 char Map::getTile(int x, int y) const {
-    if (y < 0 || y >= static_cast<int>(grid.size()) ||
-        x < 0 || x >= static_cast<int>(grid[y].size())) {
+    if (y < 0 || y >= height || x < 0 || x >= width) {
         return '#';  // Treat out-of-bounds as wall
     }
-    return grid[y][x];
+    return cells[index(x, y)];
 }
 
 void Map::setTile(int x, int y, char tile) {
-    if (y >= 0 && y < static_cast<int>(grid.size()) && x >= 0 && x < static_cast<int>(grid[y].size())) {
-        grid[y][x] = tile;
+    if (y >= 0 && y < height && x >= 0 && x < width) {
+        if (cells[index(x, y)] == tile) return;
+        cells[index(x, y)] = tile;
+        setWallBit(index(x, y), tile == '#');
+        buildTables();
     }
 }
 
+void Map::setWallBit(size_t cell, bool wall) {
+    const size_t row = cell / stride, column = cell % stride;
+    uint64_t& word = wallBits[row * rowWords + column / 64];
+    const uint64_t bit = uint64_t(1) << (column % 64);
+    word = wall ? (word | bit) : (word & ~bit);
+}
+
 void Map::display() const {
-    for (const auto& row : grid) {
-        std::cout << row << "\n";
+    for (int y = 0; y < height; y++) {
+        std::cout << std::string(&cells[index(0, y)], width) << "\n";
     }
 }
 
@@ -44,7 +74,7 @@ void Map::display(int xC, int yC) const {
                 std::cout << "C";
             }
             else{
-                std::cout << grid[y][x];
+                std::cout << tileAt(x, y);
             }
         }
         std::cout<<"\n";
@@ -54,7 +84,7 @@ void Map::display(int xC, int yC) const {
 bool Map::find(char c, int& startX, int& startY) const {
     for (int y = 0; y < getHeight(); y++) {
         for (int x = 0; x < getWidth(); x++) {
-            if (grid[y][x] == c) {
+            if (tileAt(x, y) == c) {
                 startX = x;
                 startY = y;
                 return true;
@@ -63,3 +93,117 @@ bool Map::find(char c, int& startX, int& startY) const {
     }
     return false; 
 }
+
+// Rows are scanned on the wall bitset a word at a time, columns tile by tile.
+// The border guarantees a wall before the scan leaves the grid.
+int Map::freeRun(int x, int y, Direction dir) const {
+    if (dir == UP || dir == DOWN) {
+        const ptrdiff_t step = dir == UP ? -stride : stride;
+        size_t cell = index(x, y) + step;
+        int run = 0;
+        while (cells[cell] != '#') {
+            ++run;
+            cell += step;
+        }
+        return run;
+    }
+
+    const uint64_t* row = wallBits.data() + static_cast<size_t>(y + BORDER) * rowWords;
+    if (dir == RIGHT) {
+        const int start = x + BORDER + 1;
+        for (int p = start;; p = (p | 63) + 1) {
+            const uint64_t walls = row[p / 64] >> (p % 64);
+            if (walls) return p + __builtin_ctzll(walls) - start;
+        }
+    }
+    const int start = x + BORDER - 1;
+    for (int p = start;; p = (p & ~63) - 1) {
+        const uint64_t walls = row[p / 64] << (63 - p % 64);
+        if (walls) return start - (p - __builtin_clzll(walls));
+    }
+}
+
+int Map::goalDistance(int x, int y) const {
+    if (y < 0 || y >= getHeight() || x < 0 || x >= getWidth()) return -1;
+    return goalDist[y * getWidth() + x];
+}
+
+int Map::wallDistance(int x, int y, Direction dir) const {
+    if (y < 0 || y >= getHeight() || x < 0 || x >= getWidth()) return 0;
+    return wallDist[(y * getWidth() + x) * 4 + dir];
+}
+
+void Map::buildTables() {
+    buildGoalDistance();
+    buildWallDistance();
+}
+
+// Rows come from the wall bitset, columns from one sweep each: a cell sees one
+// more free tile than its neighbour above (below), or none when that is a wall.
+void Map::buildWallDistance() {
+    PROFILE_SCOPE("map_wall_rays");
+    const int w = getWidth(), h = getHeight();
+    wallDist.assign(static_cast<size_t>(w) * h * 4, 0);
+    auto dist = [&](int x, int y, Direction dir) -> int& { return wallDist[(y * w + x) * 4 + dir]; };
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            dist(x, y, LEFT) = freeRun(x, y, LEFT);
+            dist(x, y, RIGHT) = freeRun(x, y, RIGHT);
+        }
+    }
+    for (int x = 0; x < w; ++x) {
+        for (int y = 1; y < h; ++y) {
+            if (!isWall(x, y - 1)) dist(x, y, UP) = dist(x, y - 1, UP) + 1;
+        }
+        for (int y = h - 2; y >= 0; --y) {
+            if (!isWall(x, y + 1)) dist(x, y, DOWN) = dist(x, y + 1, DOWN) + 1;
+        }
+    }
+}
+
+// Steps from the goal over road tiles ('.' and 'G'), then for every cell the
+// fewest '.' tiles entered on the way: the goal itself is free, so a cell next
+// to a road tile at step distance s needs s of them. Any cell (the start, a
+// wall) gets the value of its best road neighbour. Runs on padded indices, the
+// border is never road so neighbours need no bounds checks.
+void Map::buildGoalDistance() {
+    PROFILE_SCOPE("map_goal_bfs");
+    const int w = getWidth(), h = getHeight();
+    goalDist.assign(static_cast<size_t>(w) * h, -1);
+
+    int gX = -1, gY = -1;
+    if (!find('G', gX, gY)) return;
+
+    auto isRoad = [&](size_t cell) { return cells[cell] == '.' || cells[cell] == 'G'; };
+    const ptrdiff_t neighbours[] = {-stride, stride, -1, 1};
+
+    std::vector<int> steps(cells.size(), -1);
+    std::queue<size_t> q;
+    steps[index(gX, gY)] = 0;
+    q.push(index(gX, gY));
+    while (!q.empty()) {
+        size_t cell = q.front(); q.pop();
+        for (ptrdiff_t offset : neighbours) {
+            size_t next = cell + offset;
+            if (isRoad(next) && steps[next] == -1) {
+                steps[next] = steps[cell] + 1;
+                q.push(next);
+            }
+        }
+    }
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int best = -1;
+            for (ptrdiff_t offset : neighbours) {
+                size_t next = index(x, y) + offset;
+                if (!isRoad(next)) continue;
+                int s = steps[next];
+                if (s != -1 && (best == -1 || s < best)) best = s;
+            }
+            goalDist[y * w + x] = best;
+        }
+    }
+    goalDist[gY * w + gX] = 0;
+}
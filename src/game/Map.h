@@ -1,20 +1,55 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
+#include "../Utils.h"
 
+// The track is stored as one row-major byte array with a BORDER of walls on
+// every side, so the car (at most 5 tiles per step) and the distance searches
+// never need bounds checks. A parallel bitset marks the walls, one bit per
+// padded cell, for scans 64 cells at a time.
 class Map {
 public:
+    static constexpr int BORDER = 8;
+
     Map();
     bool loadFromFile(const std::string& filename);
+    // any coordinates, out-of-bounds reads as a wall
     char getTile(int x, int y) const;
     void setTile(int x, int y, char tile);
     void display() const;
     void display(int x, int y) const;
 
+    // unchecked, x and y may be up to BORDER cells outside the map
+    char tileAt(int x, int y) const { return cells[index(x, y)]; }
+    bool isWall(int x, int y) const { return tileAt(x, y) == '#'; }
+    // free tiles from (x, y) to the first wall looking in `dir`, scanned on the grid
+    int freeRun(int x, int y, Direction dir) const;
+
     bool find(char c, int& startX, int& startY) const;
-    int getWidth() const { return grid.empty() ? 0 : grid[0].size(); }
-    int getHeight() const { return grid.size(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // '.' tiles between (x, y) and the goal along the shortest road path, -1 if unreachable
+    int goalDistance(int x, int y) const;
+    // free tiles from (x, y) to the first wall looking in `dir`, 0 outside the map
+    int wallDistance(int x, int y, Direction dir) const;
 
 private:
-    std::vector<std::string> grid;
+    size_t index(int x, int y) const { return static_cast<size_t>(y + BORDER) * stride + (x + BORDER); }
+    void setWallBit(size_t cell, bool wall);
+
+    // distance tables, rebuilt whenever the grid changes
+    void buildTables();
+    void buildGoalDistance();
+    void buildWallDistance();
+
+    int width = 0;
+    int height = 0;
+    int stride = 0;             // width + 2 * BORDER
+    int rowWords = 0;           // 64 bit words per padded row of wallBits
+    std::vector<char> cells;    // (height + 2 * BORDER) rows of `stride` tiles
+    std::vector<uint64_t> wallBits;
+    std::vector<int> goalDist;  // row-major, width * height
+    std::vector<int> wallDist;  // row-major, 4 per cell in Direction order
 };
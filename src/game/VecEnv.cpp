@@ -0,0 +1,110 @@
+#include "VecEnv.h"
+#include "../Log.h"
+#include <algorithm>
+#include <iostream>
+
+VecEnv::VecEnv(const Map& map, int numEnvs, int randomStartFrequency, unsigned seed)
+    : map(map), random_start_frequency(randomStartFrequency), rng(seed) {
+    for (int cy = 0; cy < map.getHeight(); ++cy) {
+        for (int cx = 0; cx < map.getWidth(); ++cx) {
+            if (!map.isWall(cx, cy) && map.tileAt(cx, cy) != 'G') {
+                freeCells.emplace_back(cx, cy);
+            }
+        }
+    }
+    if (!map.find('S', startX, startY)) {
+        LOG_ERROR("Start position not found in the map!");
+    }
+    maxSteps = map.goalDistance(startX, startY) * 2;
+
+    x.resize(numEnvs);
+    y.resize(numEnvs);
+    velocity.resize(numEnvs);
+    dir.resize(numEnvs);
+    isFinished.resize(numEnvs);
+    randomStart.resize(numEnvs);
+    steps.resize(numEnvs);
+    prevDist.resize(numEnvs);
+    reward.resize(numEnvs);
+    episodeStartX.resize(numEnvs);
+    episodeStartY.resize(numEnvs);
+    episodeActions.resize(numEnvs);
+    visitedWords = (static_cast<size_t>(map.getWidth()) * map.getHeight() + 63) / 64;
+    visited.resize(visitedWords * numEnvs);
+
+    for (int i = 0; i < numEnvs; ++i) reset(i);
+}
+
+void VecEnv::reset(int i) {
+    const int episode = episodesStarted++;
+    randomStart[i] = episode % random_start_frequency == 0 && !freeCells.empty();
+    if (randomStart[i]) {
+        std::uniform_int_distribution<size_t> dis(0, freeCells.size() - 1);
+        const auto& cell = freeCells[dis(rng)];
+        x[i] = cell.first;
+        y[i] = cell.second;
+    } else {
+        x[i] = startX;
+        y[i] = startY;
+    }
+    velocity[i] = 1;
+    dir[i] = UP;
+    isFinished[i] = 0;
+    steps[i] = 0;
+    prevDist[i] = map.goalDistance(x[i], y[i]);
+    reward[i] = 0.0;
+    episodeStartX[i] = x[i];
+    episodeStartY[i] = y[i];
+    episodeActions[i].clear();
+    std::fill(visited.begin() + i * visitedWords, visited.begin() + (i + 1) * visitedWords, 0);
+}
+
+void VecEnv::step(const int* actions, double* rewards, uint8_t* dones) {
+    const int width = map.getWidth();
+
+    for (int i = 0; i < size(); ++i) {
+        const int newDist = map.goalDistance(x[i], y[i]);
+
+        episodeActions[i].push_back(static_cast<uint8_t>(actions[i]));
+        Direction heading = static_cast<Direction>(dir[i]);
+        applyCarAction(actions[i], heading, velocity[i]);
+        dir[i] = heading;
+        const UpdateStatus status = moveCar(map, x[i], y[i], heading, velocity[i]);
+
+        const size_t cell = static_cast<size_t>(y[i]) * width + x[i];
+        uint64_t& word = visited[i * visitedWords + cell / 64];
+        const uint64_t bit = uint64_t(1) << (cell % 64);
+        const bool revisited = (word & bit) != 0;
+        word |= bit;
+
+        bool done;
+        const double r = stepReward(prevDist[i], newDist, bestDist, randomStart[i], revisited, status, done);
+        rewards[i] = r;
+        dones[i] = done;
+        reward[i] += r;
+        prevDist[i] = newDist;
+        isFinished[i] = done || ++steps[i] >= maxSteps;
+    }
+}
+
+Episode VecEnv::episode(int i, uint32_t number) const {
+    Episode ep;
+    ep.episode = number;
+    ep.startX = episodeStartX[i];
+    ep.startY = episodeStartY[i];
+    ep.actions = episodeActions[i];
+    return ep;
+}
+
+int VecEnv::resetFinished() {
+    int count = 0;
+    for (int i = 0; i < size(); ++i) {
+        if (!isFinished[i]) continue;
+        if (prevDist[i] < bestDist && !randomStart[i]) {
+            bestDist = prevDist[i];
+        }
+        reset(i);
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Car.h"
+#include "EpisodeLog.h"
+#include "Map.h"
+#include "../AI/State.h"
+
+// state of a car at (x, y), distances read from the map's precomputed tables
+inline State observe(const Map& map, int x, int y, Direction dir, int speed) {
+    return State(x, y, dir, speed,
+                 map.wallDistance(x, y, UP), map.wallDistance(x, y, RIGHT),
+                 map.wallDistance(x, y, DOWN), map.wallDistance(x, y, LEFT),
+                 map.goalDistance(x, y));
+}
+
+// Reward of one training step, shared by every trainer; `done` is set when the
+// step ends the episode in the goal or a crash. dist is the goal distance
+// observed before this step's move and prevDist the one before the previous
+// step (-1 when unreachable). The bonus for beating bestDist only pays on
+// episodes that started at 'S'. `revisited`: the car ended on a cell it had
+// already visited this episode.
+inline double stepReward(int prevDist, int dist, int bestDist, bool randomStart, bool revisited,
+                         UpdateStatus status, bool& done) {
+    double reward = 0.0;
+    if (dist != -1 && prevDist != -1) {
+        double improvement = prevDist - dist;
+        reward += 5.0 * improvement;
+        // more reward for best distance
+        if (dist < bestDist && !randomStart) {
+            reward += 3.0 * improvement;
+        }
+    }
+
+    // time penalty
+    reward -= 1;
+
+    // prevents loop
+    if (revisited) reward -= 5.0;
+
+    done = false;
+    if (status == UpdateStatus::GOAL || dist < 5) {
+        reward += 500.0;
+        done = true;
+    } else if (status == UpdateStatus::COLLISION) {
+        reward -= 100.0;
+        done = true;
+    }
+    return reward;
+}
+
+// per-cell features of every position on `map`
+inline void buildFeatureTable(FeatureTable& table, const Map& map) {
+    table.build(map.getWidth(), map.getHeight(), [&](int x, int y) { return observe(map, x, y, UP, 1); });
+}
+
+// N cars driven on one shared Map, kept as structure of arrays so the whole
+// batch is stepped in one loop and encoded into one [N x NUM_FEATURES] matrix
+// for a single network call. Cars move by the rules of Car (applyCarAction,
+// moveCar) and are scored by stepReward(), like the car of train(). A finished car keeps its last position until
+// resetFinished(), so its transition can be recorded first.
+class VecEnv {
+public:
+    // every `randomStartFrequency`-th episode starts on a random free cell instead of 'S'
+    VecEnv(const Map& map, int numEnvs, int randomStartFrequency = 5, unsigned seed = std::random_device{}());
+
+    int size() const { return static_cast<int>(x.size()); }
+    State state(int i) const { return observe(map, x[i], y[i], static_cast<Direction>(dir[i]), velocity[i]); }
+    // position, direction and speed of car i as stored by the replay buffer
+    uint32_t packedState(int i) const { return packState(x[i], y[i], static_cast<Direction>(dir[i]), velocity[i]); }
+
+    // observations of every car, row i is car i
+    template <typename T>
+    void writeFeatures(const FeatureTable& table, T* out) const {
+        for (int i = 0; i < size(); ++i) {
+            table.encode(state(i), out + static_cast<size_t>(i) * State::NUM_FEATURES);
+        }
+    }
+
+    // applies actions[i] to car i and moves every car one step. dones[i] is set
+    // when the episode ended in the goal or a crash; running out of steps also
+    // finishes a car but is not a terminal transition.
+    void step(const int* actions, double* rewards, uint8_t* dones);
+    // starts a new episode for every finished car, returns how many there were
+    int resetFinished();
+
+    bool finished(int i) const { return isFinished[i] != 0; }
+    double episodeReward(int i) const { return reward[i]; }
+    int distance(int i) const { return prevDist[i]; }
+    int bestDistance() const { return bestDist; }
+    bool startedRandomly(int i) const { return randomStart[i] != 0; }
+    // start cell and actions of car i's current episode, numbered `number`
+    Episode episode(int i, uint32_t number) const;
+    // best distance of an earlier run, the shaping bonus only pays for beating it
+    void setBestDistance(int distance) { bestDist = distance; }
+
+private:
+    void reset(int i);
+
+    const Map& map;
+    int random_start_frequency;
+    std::mt19937 rng;
+    std::vector<std::pair<int, int>> freeCells;
+    int startX = 0, startY = 0;
+    int maxSteps = 0;
+    int bestDist = MAP_HEIGHT * MAP_WIDTH;
+    int episodesStarted = 0;
+
+    // one entry per car
+    std::vector<int> x, y, velocity;
+    std::vector<uint8_t> dir;
+    std::vector<uint8_t> isFinished;
+    std::vector<uint8_t> randomStart;
+    std::vector<int> steps;
+    std::vector<int> prevDist;
+    std::vector<double> reward;
+    std::vector<int> episodeStartX, episodeStartY;
+    std::vector<std::vector<uint8_t>> episodeActions;
+
+    // cells visited in the current episode, `visitedWords` bits per car
+    size_t visitedWords = 0;
+    std::vector<uint64_t> visited;
+};
@@ -1,13 +1,26 @@
 #include "Agent.h"
+#include "Kernels.h"
 #include "State.h"
+#include "StaticNetwork.h"
+#include "TrainingState.h"
 #include "game/Map.h"
 #include "game/Car.h"
 #include "game/Game.h"
+#include "game/VecEnv.h"
+#include "game/EpisodeLog.h"
+#include "Log.h"
+#include "Profiler.h"
+#include "TrajectoryStream.h"
 #include <unordered_set>
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
 #include <filesystem> 
 #include <functional> 
+#include <memory>
+#include <mutex>
+#include <thread>
 
 struct pair_hash {
     std::size_t operator()(const std::pair<int, int>& p) const {
@@ -15,10 +28,92 @@ struct pair_hash {
     }
 };
 
-void displayTrackWithMovement(const std::string& trackFilePath, const std::string& movementFilePath);
+// networks and training state in save_path/resume, overwritten every time. While
+// actors fill the replay memory, its position is read through `shared`.
+void saveSnapshot(Agent& agent, TrainingState& state, const std::string& save_path,
+                  SharedReplayBuffer* shared = nullptr) {
+    PROFILE_SCOPE("checkpoint");
+    std::string resume_path = save_path + "/resume";
+    std::filesystem::create_directories(resume_path);
+
+    state.epsilon = agent.epsilon;
+    state.learn_steps = agent.learn_steps;
+    state.agent_rng = agent.rng;
+    if (shared) {
+        shared->position(state.replay_added, state.replay_rng);
+    } else {
+        state.replay_rng = agent.replay_buffer.generator();
+        state.replay_added = agent.replay_buffer.added();
+    }
+    if (agent.q_network.saveCheckpoint(resume_path + "/q_network.rlck")
+        && agent.target_q_network.saveCheckpoint(resume_path + "/target_q_network.rlck")) {
+        saveTrainingState(resume_path + "/training_state.rlts", state);
+    }
+}
+
+// counterpart of saveSnapshot() for an agent whose q-network was loaded from save_path/resume
+bool resumeSnapshot(Agent& agent, TrainingState& state, const std::string& save_path) {
+    std::string resume_path = save_path + "/resume";
+    if (!loadTrainingState(resume_path + "/training_state.rlts", state)
+        || !agent.target_q_network.loadCheckpoint(resume_path + "/target_q_network.rlck")) {
+        return false;
+    }
+
+    agent.epsilon = state.epsilon;
+    agent.learn_steps = state.learn_steps;
+    agent.rng = state.agent_rng;
+    agent.replay_buffer.generator() = state.replay_rng;
+    // a replay file also holds the transitions added between the snapshot and the end of the run
+    if (agent.replay_buffer.fileBacked() && !agent.replay_buffer.rollBack(state.replay_added)) {
+        LOG_WARN("Continuing with the replay file as it is, the run will not repeat the original one");
+    }
+    LOG_INFO("Resuming at episode " << state.episode << " with " << agent.replay_buffer.size()
+             << " replayed transitions, epsilon " << agent.epsilon);
+    return true;
+}
+
+// epsilon decay, periodic checkpoints and target sync after every episode,
+// then state.episode moves on to the next one
+void endEpisode(Agent& agent, TrainingState& state, const std::string& save_path, int save_frequency,
+                int snapshot_frequency, SharedReplayBuffer* shared = nullptr) {
+    const int episode = state.episode++;
+    if (agent.epsilon > agent.min_epsilon) {
+        agent.epsilon *= agent.epsilon_decay;
+        if (agent.epsilon < agent.min_epsilon) agent.epsilon = agent.min_epsilon;
+    }
+
+    if (episode % save_frequency == 0) {
+        PROFILE_SCOPE("checkpoint");
+        std::string episode_save_path = save_path + "/episode_" + std::to_string(episode);
+        std::filesystem::create_directories(episode_save_path);
+
+        agent.q_network.saveCheckpoint(episode_save_path + "/q_network.rlck");
+        agent.target_q_network.saveCheckpoint(episode_save_path + "/target_q_network.rlck");
+        LOG_INFO("💾 Saved networks at episode " << episode);
+    }
+
+    // with a soft update the target already tracks the q-network every step
+    if (agent.target_tau == 0.0 && episode % 100 == 0) {
+        agent.update_target_network();
+    }
+
+    if (state.episode % snapshot_frequency == 0) {
+        saveSnapshot(agent, state, save_path, shared);
+    }
+    profiler::endEpisode(episode);
+}
+
+void saveFinal(Agent& agent, const std::string& save_path) {
+    std::string final_save_path = save_path + "/final";
+    std::filesystem::create_directories(final_save_path);
+
+    agent.q_network.saveCheckpoint(final_save_path + "/q_network.rlck");
+    agent.target_q_network.saveCheckpoint(final_save_path + "/target_q_network.rlck");
+    LOG_INFO("Saved final networks to " << final_save_path);
+}
 
 // training loop
-void train(Agent& agent, Map& map, int episodes, const std::string& save_path) {
+void train(Agent& agent, Map& map, TrainingState& state, int episodes, const std::string& save_path) {
     
     // free cells used as random starting points
     std::vector<std::pair<int, int>> freeCells;
@@ -30,44 +125,46 @@ void train(Agent& agent, Map& map, int episodes, const std::string& save_path) {
         }
     }
 
+    buildFeatureTable(agent.state_features, map);
+
     if (!std::filesystem::exists(save_path)) {
         if (!std::filesystem::create_directories(save_path)) {
-            std::cerr << " Could not create save directory: " << save_path << std::endl;
+            LOG_ERROR(" Could not create save directory: " << save_path);
             return;
         }
     }
 
-    std::ofstream movementFile("./assets/movements.txt", std::ios::app);
-    if (!movementFile.is_open()) {
-        std::cerr << "Failed to open movements.txt\n";
+    EpisodeLogWriter episodeLog;
+    if (!episodeLog.open("./assets/episodes.rlep")) {
         return;
     }
 
     int startX = -1, startY = -1;
     if (!map.find('S', startX, startY)) {
-        std::cerr << "Start position not found in the map!\n";
-        movementFile.close();
+        LOG_ERROR("Start position not found in the map!");
         return;
     }
 
+    // episodes for the live visualizer, training goes on without it
+    TrajectoryWriter trajectories;
+    if (trajectories.open()) {
+        LOG_INFO("Streaming trajectories to " << TRAJECTORY_STREAM_NAME << ", run ./visualizer to watch");
+    }
+
     Car car(startX, startY);
     int prevDist = car.minDotsToGoal(map);
     int maxSteps = prevDist * 2;
 
     int save_frequency = 5000;
+    int snapshot_frequency = 100;
     int random_start_frequency = 5;
-    int display_movements_frequency = 3000;
     int save_movements_frequency = 1000;
-    int bestDist = MAP_HEIGHT * MAP_WIDTH;
+    int& bestDist = state.best_distance;
 
-    for (int episode = 0; episode < episodes; ++episode) {
+    while (state.episode < episodes) {
+        const int episode = state.episode;
         std::vector<std::pair<int, int>> episodeMovements;
-
-        if (episode > 0 && episode % display_movements_frequency == 0) {
-            if (movementFile.is_open()) movementFile.close();
-            displayTrackWithMovement("./assets/track.txt", "./assets/movements.txt");
-            movementFile.open("./assets/movements.txt", std::ios::app);
-        }
+        std::vector<uint8_t> episodeActions;
 
         int carStartX = startX;
         int carStartY = startY;
@@ -78,10 +175,8 @@ void train(Agent& agent, Map& map, int episodes, const std::string& save_path) {
         // random start
         if ( randomStartEpisode && !logEpisode) {
             if (!freeCells.empty()) {
-                static std::random_device rd;
-                static std::mt19937 gen(rd());
                 std::uniform_int_distribution<> dis(0, freeCells.size() - 1);
-                auto randomCell = freeCells[dis(gen)];
+                auto randomCell = freeCells[dis(state.start_rng)];
                 carStartX = randomCell.first;
                 carStartY = randomCell.second;
             }
@@ -100,67 +195,27 @@ void train(Agent& agent, Map& map, int episodes, const std::string& save_path) {
             int x = car.getX();
             int y = car.getY();
 
-            int distU = 0, distR = 0, distD = 0, distL = 0;
-            int newDist = car.minDotsToGoal(map);
-            
-            // calculate distance from wall
-            for (int i = y - 1; i >= 0; --i) if (map.getTile(x, i) == '#') break; else distU++;
-            for (int i = x + 1; i < MAP_WIDTH; ++i) if (map.getTile(i, y) == '#') break; else distR++;
-            for (int i = y + 1; i < MAP_HEIGHT; ++i) if (map.getTile(x, i) == '#') break; else distD++;
-            for (int i = x - 1; i >= 0; --i) if (map.getTile(i, y) == '#') break; else distL++;
-
             // create the state
-            State currentState(x, y, car.getDirection(), car.getVelocity());
-            currentState.distU = distU;
-            currentState.distR = distR;
-            currentState.distD = distD;
-            currentState.distL = distL;
-            currentState.distG = newDist;
+            State currentState = observe(map, x, y, car.getDirection(), car.getVelocity());
+            int newDist = currentState.distG;
 
             int action = agent.select_action(currentState);
 
             // action selected by the network
-            switch (action) {
-                case 0: car.accelerate(); break;
-                case 1: car.decelerate(); break;
-                case 2: car.getDirection() == RIGHT ? car.decelerate() : car.setDirection(LEFT); break;
-                case 3: car.getDirection() == LEFT ? car.decelerate() : car.setDirection(RIGHT); break;
-                case 4: car.getDirection() == DOWN ? car.decelerate() : car.setDirection(UP); break;
-                case 5: car.getDirection() == UP ? car.decelerate() : car.setDirection(DOWN); break;
-                default: std::cerr << "Unknown action: " << action << "\n"; break;
-            }
-
-            UpdateStatus status = car.update(map);
-            
-            double reward = 0.0;
-            if (newDist != -1 && prevDist != -1) {
-                double improvement = prevDist - newDist;
-                reward += 5.0 * improvement;
-
-                // more reward for best distance
-                if (newDist < bestDist && !(randomStartEpisode)) {
-                    reward += 3.0*improvement;
-                }
-            }
+            car.applyAction(action);
+            episodeActions.push_back(static_cast<uint8_t>(action));
 
-            // time penalty
-            reward -= 1;
-
-            // prevents loop
-            if (visited.count({car.getX(), car.getY()})) reward -= 5.0;
-            visited.insert({car.getX(), car.getY()});
-
-            // conditions that end the episode
-            if (status == UpdateStatus::GOAL || newDist < 5) {
-                reward += 500.0;
-                done = true;
-            } else if (status == UpdateStatus::COLLISION) {
-                reward -= 100.0;
-                done = true;
+            UpdateStatus status;
+            {
+                PROFILE_SCOPE("car_update");
+                status = car.update(map);
             }
+            
+            const bool revisited = !visited.insert({car.getX(), car.getY()}).second;
+            double reward = stepReward(prevDist, newDist, bestDist, randomStartEpisode, revisited, status, done);
 
-            State nextState(car.getX(), car.getY(), car.getDirection(), car.getVelocity());
-            agent.store_transition(currentState, action, reward/1000, nextState, done);
+            State nextState = observe(map, car.getX(), car.getY(), car.getDirection(), car.getVelocity());
+            agent.store_transition(currentState, action, reward/1000, nextState, done, step + 1 == maxSteps);
             agent.experience_replay(64);
 
             episodeReward += reward;
@@ -174,54 +229,346 @@ void train(Agent& agent, Map& map, int episodes, const std::string& save_path) {
         }
 
         if (logEpisode || (newBestPath && !randomStartEpisode)) {
-            for (const auto& pos : episodeMovements) {
-                if (movementFile.is_open()) {
-                    movementFile << pos.first << " " << pos.second << "\n";
-                }
-            }
+            PROFILE_SCOPE("visualizer");
+            Episode logged;
+            logged.episode = episode;
+            logged.startX = carStartX;
+            logged.startY = carStartY;
+            logged.actions = std::move(episodeActions);
+            episodeLog.append(logged);
+            trajectories.publish(episode, episodeMovements);
         }
         
 
-        std::cout << "📘 Episode " << episode
-                  << " | Total reward: " << episodeReward
-                  << " | Current Distance: " << prevDist
-                  << " | Best Distance: " << bestDist
-                  << " | Epsilon: " << agent.epsilon << "\n";
+        LOG_INFO("📘 Episode " << episode
+                 << " | Total reward: " << episodeReward
+                 << " | Current Distance: " << prevDist
+                 << " | Best Distance: " << bestDist
+                 << " | Epsilon: " << agent.epsilon);
+
+        endEpisode(agent, state, save_path, save_frequency, snapshot_frequency);
+    }
 
-        // epsilon decay
-        if (agent.epsilon > agent.min_epsilon) {
-            agent.epsilon *= agent.epsilon_decay;
-            if (agent.epsilon < agent.min_epsilon) agent.epsilon = agent.min_epsilon;
+    saveFinal(agent, save_path);
+}
+
+// Logged episodes of the vectorized trainers, kept like train()'s: every
+// `save_movements_frequency`-th episode and every new best run from 'S' goes to
+// the episode log and the visualizer stream. The actors share one recorder, the
+// lock keeps their appends whole and the stream to a single writer.
+class EpisodeRecorder {
+public:
+    explicit EpisodeRecorder(const Map& map) : map(map) {}
+
+    bool open() {
+        if (!episodeLog.open("./assets/episodes.rlep")) return false;
+        // training goes on without the visualizer
+        if (trajectories.open()) {
+            LOG_INFO("Streaming trajectories to " << TRAJECTORY_STREAM_NAME << ", run ./visualizer to watch");
         }
+        return true;
+    }
+
+    // before env.resetFinished(), which folds a new best into env.bestDistance()
+    void record(const VecEnv& env, int i, int episode) {
+        const bool newBestPath = !env.startedRandomly(i) && env.distance(i) < env.bestDistance();
+        if (episode % save_movements_frequency != 0 && !newBestPath) return;
+
+        PROFILE_SCOPE("visualizer");
+        Episode logged = env.episode(i, episode);
+        std::vector<std::pair<int, int>> path = replayEpisode(map, logged);
+        std::lock_guard<std::mutex> lock(mutex);
+        episodeLog.append(logged);
+        trajectories.publish(episode, path);
+    }
+
+private:
+    static constexpr int save_movements_frequency = 1000;
+    const Map& map;
+    std::mutex mutex;
+    EpisodeLogWriter episodeLog;
+    TrajectoryWriter trajectories;
+};
+
+// N cars stepped together: one batched action selection and N stored
+// transitions per step, followed by one replay step like train()
+void trainVectorized(Agent& agent, Map& map, TrainingState& state, int numEnvs, int episodes,
+                     const std::string& save_path) {
+    if (!std::filesystem::exists(save_path) && !std::filesystem::create_directories(save_path)) {
+        LOG_ERROR(" Could not create save directory: " << save_path);
+        return;
+    }
+
+    EpisodeRecorder recorder(map);
+    if (!recorder.open()) {
+        return;
+    }
 
-        if (episode % save_frequency == 0) {
-            std::string episode_save_path = save_path + "/episode_" + std::to_string(episode);
-            std::filesystem::create_directories(episode_save_path + "/q_network");
-            std::filesystem::create_directories(episode_save_path + "/target_q_network");
+    buildFeatureTable(agent.state_features, map);
+    // cars that were on the road when the run stopped start over
+    VecEnv env(map, numEnvs, 5, state.start_rng());
+    env.setBestDistance(state.best_distance);
+    agent.replay_buffer.setStride(numEnvs);
 
-            agent.q_network.save(episode_save_path + "/q_network");
-            agent.target_q_network.save(episode_save_path + "/target_q_network");
-            std::cout << "💾 Saved networks at episode " << episode << "\n";
+    int save_frequency = 5000;
+    int snapshot_frequency = 100;
+    int log_frequency = 100;
+
+    std::vector<net_scalar> features(static_cast<size_t>(numEnvs) * State::NUM_FEATURES);
+    std::vector<uint32_t> states(numEnvs);
+    std::vector<int> actions(numEnvs);
+    std::vector<double> rewards(numEnvs);
+    std::vector<uint8_t> dones(numEnvs);
+
+    while (state.episode < episodes) {
+        env.writeFeatures(agent.state_features, features.data());
+        for (int i = 0; i < numEnvs; ++i) states[i] = env.packedState(i);
+
+        agent.select_actions(features.data(), numEnvs, actions.data());
+        {
+            PROFILE_SCOPE("env_step");
+            env.step(actions.data(), rewards.data(), dones.data());
         }
 
-        if (episode % 100 == 0) {
-            agent.update_target_network();
+        // finished cars still hold their last position here, resetFinished() comes later
+        for (int i = 0; i < numEnvs; ++i) {
+            agent.replay_buffer.add(states[i], actions[i], rewards[i] / 1000, env.packedState(i), dones[i], env.finished(i));
+        }
+        agent.experience_replay(64);
+
+        for (int i = 0; i < numEnvs && state.episode < episodes; ++i) {
+            if (!env.finished(i)) continue;
+            recorder.record(env, i, state.episode);
+            if (state.episode % log_frequency == 0) {
+                LOG_INFO("📘 Episode " << state.episode
+                         << " | Total reward: " << env.episodeReward(i)
+                         << " | Current Distance: " << env.distance(i)
+                         << " | Best Distance: " << env.bestDistance()
+                         << " | Epsilon: " << agent.epsilon);
+            }
+            state.best_distance = env.bestDistance();
+            endEpisode(agent, state, save_path, save_frequency, snapshot_frequency);
         }
+        env.resetFinished();
     }
 
-    std::string final_save_path = save_path + "/final";
-    std::filesystem::create_directories(final_save_path + "/q_network");
-    std::filesystem::create_directories(final_save_path + "/target_q_network");
+    saveFinal(agent, save_path);
+}
+
+// The weights an actor acts on. With the production topology they live in the
+// compile-time ProductionNetwork, which evaluates a state about 2.5x faster than
+// the general network (static_network_forward_* in `make bench`), any other
+// layer sizes use a TargetNetwork.
+class ActorPolicy {
+public:
+    explicit ActorPolicy(const NeuralNetwork& source) {
+        if (ProductionNetwork::matches(source)) {
+            fast = std::make_unique<ProductionNetwork>();
+            fast->copyFrom(source);
+        } else {
+            general = std::make_unique<TargetNetwork>(source);
+        }
+    }
 
-    agent.q_network.save(final_save_path + "/q_network");
-    agent.target_q_network.save(final_save_path + "/target_q_network");
-    std::cout << "Saved final networks to " << final_save_path << std::endl;
+    // learner side: the current weights of `source`, which has the same layer sizes
+    void copyFrom(const NeuralNetwork& source) {
+        if (fast) fast->copyFrom(source);
+        else general->copyFrom(source);
+    }
 
-    if (movementFile.is_open()) movementFile.close();
-}
+    // actor side: the weights of a policy built from the same network
+    void assign(const ActorPolicy& other) {
+        if (fast) *fast = *other.fast;
+        else *general = *other.general;
+    }
+
+    // Q-values of `count` encoded states as a [count x outputSize()] matrix, valid until the next call
+    const net_scalar* forward(const net_scalar* states, int count) {
+        if (!fast) return general->forward(states, count, NeuralNetwork::threadWorkspace());
+        q_values.resize(static_cast<size_t>(count) * ProductionNetwork::outputSize());
+        fast->forwardBatch(states, count, q_values.data());
+        return q_values.data();
+    }
+
+    int outputSize() const { return fast ? ProductionNetwork::outputSize() : general->outputSize(); }
+
+private:
+    std::unique_ptr<ProductionNetwork> fast;
+    std::unique_ptr<TargetNetwork> general;
+    std::vector<net_scalar> q_values;
+};
+
+// Actor-learner training. `numActors` threads each drive their own VecEnv of
+// `envsPerActor` cars with a private copy of the policy and push transitions
+// into a shared replay buffer, while the calling thread keeps learning.
+// replayRatio is the number of replayed samples per collected transition (the
+// serial loop replays 64); whichever side gets ahead waits for the other. The
+// actors pick up new weights every `publishInterval` gradient steps. A snapshot
+// misses the transitions actors have not handed over yet and cars stop
+// mid-episode, so a resumed run only approximately continues the original.
+void trainActorLearner(Agent& agent, Map& map, TrainingState& state, int numActors, int envsPerActor, int episodes,
+                       double replayRatio, int publishInterval, const std::string& save_path) {
+    if (!std::filesystem::exists(save_path) && !std::filesystem::create_directories(save_path)) {
+        LOG_ERROR(" Could not create save directory: " << save_path);
+        return;
+    }
+
+    EpisodeRecorder recorder(map);
+    if (!recorder.open()) {
+        return;
+    }
+
+    buildFeatureTable(agent.state_features, map);
+
+    const size_t batch_size = 64;
+    const size_t actor_chunk = 32;           // transitions an actor collects before taking the buffer lock
+    const double max_actor_lead = 4096;      // collected transitions allowed ahead of the replay ratio
+    int save_frequency = 5000;
+    int snapshot_frequency = 100;
+    int log_frequency = 100;
+
+    SharedReplayBuffer replay(agent.replay_buffer, envsPerActor);
+    std::atomic<size_t> collected{0};
+    std::atomic<size_t> learnSteps{0};
+    std::atomic<int> episodesDone{state.episode};
+    std::atomic<double> epsilon{agent.epsilon};
+    // best distance over all actors, every car's shaping bonus pays for beating it
+    std::atomic<int> bestDistance{state.best_distance};
+    std::atomic<bool> stop{false};
+    std::mutex progressMutex;
+    std::condition_variable progress;
+
+    // weights published by the learner, `version` bumps on every publish. The actors'
+    // copies are made here, before the learner starts changing the network.
+    std::mutex publishMutex;
+    ActorPolicy published(agent.q_network);
+    std::atomic<uint64_t> version{0};
+    std::vector<ActorPolicy> policies;
+    for (int id = 0; id < numActors; ++id) policies.emplace_back(agent.q_network);
+
+    auto actor = [&](int id) {
+        VecEnv env(map, envsPerActor, 5, std::random_device{}() + id);
+        env.setBestDistance(bestDistance.load());
+        std::mt19937 rng(std::random_device{}() ^ (id * 7919u));
+        uint64_t seen = 0;
+        ActorPolicy& policy = policies[id];
+
+        std::vector<net_scalar> features(static_cast<size_t>(envsPerActor) * State::NUM_FEATURES);
+        std::vector<uint32_t> states(envsPerActor);
+        std::vector<int> actions(envsPerActor);
+        std::vector<double> rewards(envsPerActor);
+        std::vector<uint8_t> dones(envsPerActor);
+        ReplayBuffer pending(actor_chunk + envsPerActor);
+
+        while (!stop) {
+            if (version.load() != seen) {
+                std::lock_guard<std::mutex> lock(publishMutex);
+                policy.assign(published);
+                seen = version.load();
+            }
+
+            // the short timeout covers notifications sent between the check and the wait
+            {
+                std::unique_lock<std::mutex> lock(progressMutex);
+                while (!stop && collected * replayRatio > learnSteps * batch_size + max_actor_lead * replayRatio) {
+                    progress.wait_for(lock, std::chrono::milliseconds(1));
+                }
+            }
+
+            env.writeFeatures(agent.state_features, features.data());
+            for (int i = 0; i < envsPerActor; ++i) states[i] = env.packedState(i);
+
+            {
+                PROFILE_SCOPE("select_action");
+                const net_scalar* q_values = policy.forward(features.data(), envsPerActor);
+                Agent::choose_actions(q_values, envsPerActor, policy.outputSize(), epsilon.load(), rng, actions.data());
+            }
+            {
+                PROFILE_SCOPE("env_step");
+                env.step(actions.data(), rewards.data(), dones.data());
+            }
+
+            for (int i = 0; i < envsPerActor; ++i) {
+                pending.add(states[i], actions[i], rewards[i] / 1000, env.packedState(i), dones[i] != 0, env.finished(i));
+                if (!env.finished(i)) continue;
+                int episode = episodesDone++;
+                if (episode >= episodes) continue;
+                recorder.record(env, i, episode);
+                if (episode % log_frequency == 0) {
+                    LOG_INFO("📘 Episode " << episode
+                             << " | Actor " << id
+                             << " | Total reward: " << env.episodeReward(i)
+                             << " | Current Distance: " << env.distance(i)
+                             << " | Best Distance: " << env.bestDistance()
+                             << " | Epsilon: " << epsilon.load());
+                }
+            }
+            env.resetFinished();
+            // a new best of this actor lowers the shared one, and others' bests reach this actor
+            int best = bestDistance.load();
+            while (env.bestDistance() < best && !bestDistance.compare_exchange_weak(best, env.bestDistance())) {}
+            env.setBestDistance(std::min(best, env.bestDistance()));
+
+            if (pending.size() >= actor_chunk) {
+                replay.add(pending);
+                collected += pending.size();
+                pending.clear();
+                progress.notify_all();
+            }
+        }
+    };
 
+    std::vector<std::thread> actors;
+    for (int id = 0; id < numActors; ++id) actors.emplace_back(actor, id);
+
+    // learner: runs on this thread, also does the per-episode bookkeeping of train()
+    while (state.episode < episodes) {
+        const int finished = std::min(episodesDone.load(), episodes);
+        state.best_distance = bestDistance.load();
+        while (state.episode < finished) {
+            endEpisode(agent, state, save_path, save_frequency, snapshot_frequency, &replay);
+        }
+        epsilon = agent.epsilon;
+
+        {
+            std::unique_lock<std::mutex> lock(progressMutex);
+            progress.wait_for(lock, std::chrono::milliseconds(1), [&] {
+                return learnSteps * batch_size < collected * replayRatio;
+            });
+        }
+        if (replay.size() < batch_size || learnSteps * batch_size >= collected * replayRatio) continue;
+
+        replay.sample(batch_size, agent.state_features, agent.replay_batch, agent.importance_beta());
+        agent.learn_from(agent.replay_batch);
+        if (agent.replay_buffer.prioritized()) {
+            replay.updatePriorities(agent.replay_batch.indices.data(), agent.batch_td_errors.data(), batch_size);
+        }
+        ++learnSteps;
+        progress.notify_all();
+
+        if (learnSteps % publishInterval == 0) {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            published.copyFrom(agent.q_network);
+            ++version;
+        }
+    }
+
+    stop = true;
+    progress.notify_all();
+    for (auto& t : actors) t.join();
+
+    LOG_INFO("Actor-learner: " << collected.load() << " transitions collected, "
+             << learnSteps.load() << " learning steps");
+    saveFinal(agent, save_path);
+}
 
 int main() {
+    if (!kernelSelfTest()) {
+        LOG_ERROR("Vector kernels disagree with the scalar reference, aborting.");
+        return 1;
+    }
+    LOG_INFO("Using " << kernels<net_scalar>().name << " kernels");
+
     std::vector<int> layerSizes = {9, 128, 128, 6};
     size_t buffer_capacity = 100000;
     double initial_epsilon = 1.0;
@@ -230,9 +577,40 @@ int main() {
     double discount_factor = 0.95;
     int num_actions = 6;
     std::string save_directory = "./trained_agent";
+    int num_envs = 1; // more than one trains on a VecEnv of that many cars
+    int num_actors = 0; // actor threads for actor-learner training (num_envs cars each), 0 keeps one thread
+    double replay_ratio = 64.0; // replayed samples per collected transition in actor-learner training
+    int publish_interval = 100; // learning steps between weight updates sent to the actors
+    double priority_alpha = 0.0; // prioritized replay exponent, 0 samples uniformly (0.6 is the usual choice)
+    int n_step = 1; // rewards summed into each replayed target before bootstrapping, 1 is one-step Q-learning
+
+    // replay memory kept in this file instead of RAM, empty keeps it in RAM. The file may
+    // exceed RAM and survives restarts, a run that does not resume starts it over.
+    std::string replay_file = "";
+    // continue the run snapshotted in save_directory/resume (networks, epsilon, episode,
+    // random generators), with the replayed transitions when replay_file is set
+    bool resume = false;
+
+    if (num_actors > 0 && (replay_ratio <= 0.0 || publish_interval <= 0)) {
+        LOG_ERROR("replay_ratio and publish_interval must be positive for actor-learner training");
+        return 1;
+    }
 
     bool load_agent = false;
     std::string load_path = save_directory + "/episode";
+    if (resume) load_path = save_directory + "/resume";
+
+    TrainingState state;
+    auto prepare = [&](Agent& agent) {
+        agent.set_prioritized_replay(priority_alpha);
+        agent.set_n_step(n_step);
+        if (!replay_file.empty()) {
+            std::filesystem::path replay_dir = std::filesystem::path(replay_file).parent_path();
+            if (!replay_dir.empty()) std::filesystem::create_directories(replay_dir);
+            if (agent.replay_buffer.mapFile(replay_file) && !resume) agent.replay_buffer.clear();
+        }
+        return !resume || resumeSnapshot(agent, state, save_directory);
+    };
 
     if (load_agent) {
         
@@ -245,8 +623,12 @@ int main() {
                     num_actions,
                     load_path
                 );
+        if (!prepare(agent)) return 1;
         Game game;
-        train(agent, game.track, 1000000, save_directory);
+        if (num_actors > 0) trainActorLearner(agent, game.track, state, num_actors, num_envs, 1000000, replay_ratio,
+                                              publish_interval, save_directory);
+        else if (num_envs > 1) trainVectorized(agent, game.track, state, num_envs, 1000000, save_directory);
+        else train(agent, game.track, state, 1000000, save_directory);
 
     } else {
         // This block is for starting a fresh training session
@@ -257,10 +639,14 @@ int main() {
                     min_epsilon,
                     discount_factor,
                     num_actions,
-                    "no_load"
+                    resume ? load_path : "no_load"
                 );
+        if (!prepare(agent_train)) return 1;
         Game game;
-        train(agent_train, game.track, 100000, save_directory);
+        if (num_actors > 0) trainActorLearner(agent_train, game.track, state, num_actors, num_envs, 100000, replay_ratio,
+                                              publish_interval, save_directory);
+        else if (num_envs > 1) trainVectorized(agent_train, game.track, state, num_envs, 100000, save_directory);
+        else train(agent_train, game.track, state, 100000, save_directory);
     }
 
     return 0;
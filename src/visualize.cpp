@@ -1,6 +1,19 @@
 #include "UI/DisplayMovement.h"
+#include "TrajectoryStream.h"
+#include <cstdlib>
+#include <string>
 
-int main() {
-    displayTrackWithMovement("./assets/track.txt", "./assets/movements.txt");
+// default: follow a running trainer
+//   --file       replays assets/movements.txt
+//   --log [n]    browses assets/episodes.rlep from episode n (default: the latest)
+int main(int argc, char** argv) {
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--file") {
+        displayTrackWithMovement("./assets/track.txt", "./assets/movements.txt");
+    } else if (mode == "--log") {
+        displayEpisodeLog("./assets/track.txt", "./assets/episodes.rlep", argc > 2 ? std::atol(argv[2]) : -1);
+    } else {
+        displayTrajectoryStream("./assets/track.txt", TRAJECTORY_STREAM_NAME);
+    }
     return 0;
-}
\ No newline at end of file
+}